@@ -49,7 +49,10 @@ int main()
     // 7) Draw the compressed forests on file
     fh.DrawOnFile(algo_name, DrawDagFlags::DELETE_DOTCODE);
 
-    // 8) Generate the C/C++ code
+    // 8) Profile the forests on the datasets, for prediction-aware optimizations
+    ProfileForestsOnFile(fh, rs.ps_);
+
+    // 9) Generate the C/C++ code
     fh.GenerateCode();
 	GeneratePointersConditionsActionsCode(rs,
 		GenerateConditionActionCodeFlags::NONE,
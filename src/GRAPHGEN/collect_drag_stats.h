@@ -15,15 +15,18 @@
 // This class serves to efficiently collect information about each node/subtree of a tree starting from a node
 // it both stores properties of each subtree (as string) and all the parents of each node.
 struct CollectDragStatistics {
+    // Placeholder for the leaves in STreeProp::conditions_, the ID of the empty condition
+    static constexpr uint kLeaf = 0;
 
     // Utility class to calculate and store (sub)trees properties
     struct STreeProp {
-        std::string conditions_;
+        // IDs of the conditions of the subtree in depth-first order, leaves are kLeaf
+        std::vector<uint> conditions_;
         std::vector<BinaryDrag<conact>::node*> leaves_;
         BinaryDrag<conact>::node* n_;
 
         STreeProp& operator+=(const STreeProp& rhs) {
-            conditions_ += rhs.conditions_;
+            conditions_.insert(end(conditions_), begin(rhs.conditions_), end(rhs.conditions_));
             copy(begin(rhs.leaves_), end(rhs.leaves_), back_inserter(leaves_));
             return *this;
         }
@@ -60,13 +63,13 @@ struct CollectDragStatistics {
         STreeProp sp;
         sp.n_ = n;
         if (n->isleaf()) {
-            sp.conditions_ = ".";
+            sp.conditions_ = { kLeaf };
             sp.leaves_.push_back(n);
         }
         else {
             parents_[n->left].push_back(n);
             parents_[n->right].push_back(n);
-            sp.conditions_ = n->data.condition;
+            sp.conditions_ = { n->data.condition.id() };
             sp += CollectStatsRec(n->left);
             sp += CollectStatsRec(n->right);
         }
@@ -0,0 +1,207 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "compact_drag.h"
+
+#include <stdexcept>
+
+using namespace std;
+
+uint32_t drag_symbols::ActionSet(const action_set& actions) {
+    auto it = action_set_ids_.find(actions);
+    if (it != action_set_ids_.end()) {
+        return it->second;
+    }
+    action_sets_.push_back(actions);
+    return action_set_ids_[actions] = static_cast<uint32_t>(action_sets_.size() - 1);
+}
+
+CompactDrag::CompactDrag(shared_ptr<drag_symbols> symbols) : symbols_{ symbols ? move(symbols) : make_shared<drag_symbols>() } {}
+
+CompactDrag::CompactDrag(const BinaryDrag<conact>& bd, shared_ptr<drag_symbols> symbols) : CompactDrag(move(symbols)) {
+    // Index of the converted node for each node of bd, by arena index
+    vector<uint32_t> ids(bd.nodes_.size(), kNone);
+    auto convert = [&](auto&& self, const BinaryDrag<conact>::node* n) -> uint32_t {
+        uint32_t& id = ids[bd.nodes_.index_of(n)];
+        if (id == kNone) {
+            if (n->isleaf()) {
+                id = AddLeaf(n->data.action, n->data.next);
+            }
+            else {
+                uint32_t left = self(self, n->left);
+                uint32_t right = self(self, n->right);
+                id = AddNode(n->data.condition, left, right);
+            }
+        }
+        return id;
+    };
+    nodes_.reserve(bd.nodes_.size());
+    for (const auto* r : bd.roots_) {
+        roots_.push_back(convert(convert, r));
+    }
+}
+
+BinaryDrag<conact> CompactDrag::ToBinaryDrag() const {
+    BinaryDrag<conact> bd;
+    bd.nodes_.reserve(nodes_.size());
+    vector<BinaryDrag<conact>::node*> ptrs(nodes_.size());
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        const node& n = nodes_[i];
+        if (n.isleaf()) {
+            conact data;
+            data.t = conact::type::ACTION;
+            data.action = Actions(static_cast<uint32_t>(i));
+            data.next = Next(static_cast<uint32_t>(i));
+            ptrs[i] = bd.make_node(move(data));
+        }
+        else {
+            ptrs[i] = bd.make_node(conact(Condition(static_cast<uint32_t>(i))), ptrs[n.left], ptrs[n.right]);
+        }
+    }
+    for (uint32_t r : roots_) {
+        bd.AddRoot(ptrs[r]);
+    }
+    return bd;
+}
+
+uint32_t CompactDrag::AddLeaf(const action_set& actions, size_t next) {
+    if (nodes_.size() >= kNone) {
+        throw runtime_error("Too many nodes for a CompactDrag");
+    }
+    if (next >= kNone && next != numeric_limits<size_t>::max()) {
+        throw runtime_error("Next tree index too large for a CompactDrag");
+    }
+    node n;
+    n.actions = symbols_->ActionSet(actions);
+    n.next = next == numeric_limits<size_t>::max() ? kNone : static_cast<uint32_t>(next);
+    nodes_.push_back(n);
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+uint32_t CompactDrag::AddNode(condition_name condition, uint32_t left, uint32_t right) {
+    if (nodes_.size() >= kNone) {
+        throw runtime_error("Too many nodes for a CompactDrag");
+    }
+    if (condition.id() > numeric_limits<uint16_t>::max()) {
+        throw runtime_error("Condition ID too large for a CompactDrag");
+    }
+    node n;
+    n.left = left;
+    n.right = right;
+    n.condition = static_cast<uint16_t>(condition.id());
+    nodes_.push_back(n);
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+size_t CompactDrag::Nodes() const {
+    // Children precede their parents, so reachability can be propagated backwards
+    vector<char> reached(nodes_.size(), 0);
+    for (uint32_t r : roots_) {
+        reached[r] = 1;
+    }
+    size_t count = 0;
+    for (size_t i = nodes_.size(); i-- > 0;) {
+        if (reached[i] && !nodes_[i].isleaf()) {
+            reached[nodes_[i].left] = reached[nodes_[i].right] = 1;
+            ++count;
+        }
+    }
+    return count;
+}
+
+size_t CompactDrag::Leaves() const {
+    vector<char> reached(nodes_.size(), 0);
+    for (uint32_t r : roots_) {
+        reached[r] = 1;
+    }
+    size_t count = 0;
+    for (size_t i = nodes_.size(); i-- > 0;) {
+        if (reached[i]) {
+            if (nodes_[i].isleaf()) {
+                ++count;
+            }
+            else {
+                reached[nodes_[i].left] = reached[nodes_[i].right] = 1;
+            }
+        }
+    }
+    return count;
+}
+
+bool CompactDrag::EqualTrees(uint32_t a, uint32_t b) const {
+    if (a == b) {
+        return true;
+    }
+    const node& na = nodes_[a];
+    const node& nb = nodes_[b];
+    if (na.isleaf() != nb.isleaf()) {
+        return false;
+    }
+    if (na.isleaf()) {
+        return na.actions == nb.actions && na.next == nb.next;
+    }
+    return na.condition == nb.condition && EqualTrees(na.left, nb.left) && EqualTrees(na.right, nb.right);
+}
+
+namespace {
+
+struct node_key {
+    uint32_t left, right, actions, next;
+    uint16_t condition;
+
+    bool operator==(const node_key& other) const {
+        return left == other.left && right == other.right && actions == other.actions && next == other.next && condition == other.condition;
+    }
+};
+
+struct node_key_hash {
+    size_t operator()(const node_key& k) const {
+        uint64_t h = (static_cast<uint64_t>(k.left) << 32 | k.right) * 0x9E3779B97F4A7C15ull;
+        h ^= (static_cast<uint64_t>(k.actions) << 32 | k.next) + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2);
+        h ^= k.condition * 0xC2B2AE3D27D4EB4Full;
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+
+} // namespace
+
+void CompactDrag::RemoveEqualSubtrees() {
+    vector<char> reached(nodes_.size(), 0);
+    for (uint32_t r : roots_) {
+        reached[r] = 1;
+    }
+    for (size_t i = nodes_.size(); i-- > 0;) {
+        if (reached[i] && !nodes_[i].isleaf()) {
+            reached[nodes_[i].left] = reached[nodes_[i].right] = 1;
+        }
+    }
+
+    // Children are processed before their parents, so equal subtrees have equal keys
+    vector<uint32_t> ids(nodes_.size(), kNone);
+    vector<node> nodes;
+    unordered_map<node_key, uint32_t, node_key_hash> unique;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        if (!reached[i]) {
+            continue;
+        }
+        node n = nodes_[i];
+        if (!n.isleaf()) {
+            n.left = ids[n.left];
+            n.right = ids[n.right];
+        }
+        node_key k{ n.left, n.right, n.actions, n.next, n.isleaf() ? uint16_t(0) : n.condition };
+        auto it = unique.emplace(k, static_cast<uint32_t>(nodes.size()));
+        if (it.second) {
+            nodes.push_back(n);
+        }
+        ids[i] = it.first->second;
+    }
+
+    for (uint32_t& r : roots_) {
+        r = ids[r];
+    }
+    nodes_ = move(nodes);
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_COMPACT_DRAG_H_
+#define GRAPHGEN_COMPACT_DRAG_H_
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "condition_action.h"
+#include "drag.h"
+
+/** @file compact_drag.h
+
+Compact representation of a BinaryDrag<conact>, meant for the passes that
+traverse drags many times (compression, removal of duplicates, statistics).
+Nodes are stored in a single vector and refer to their children by 32-bit
+indexes, conditions are stored as their 16-bit condition_name IDs, and the
+action sets of the leaves are interned, so that a node takes 20 bytes instead
+of the ~90 of a BinaryDrag<conact>::node, and comparing two nodes never
+compares strings or bitsets.
+
+Children always precede their parents in the vector, so bottom-up passes are
+plain loops over the nodes. Passes can be moved to this representation one at
+a time, converting from and to BinaryDrag<conact> at their boundaries.
+
+ */
+
+using action_set = decltype(conact::action);
+
+/** @brief Interned action sets.
+
+Drags which share the same symbols have comparable action set IDs. Condition IDs
+are the ones of condition_name, so they are always comparable.
+*/
+struct drag_symbols {
+    std::vector<action_set> action_sets_;
+    std::unordered_map<action_set, uint32_t> action_set_ids_;
+
+    // Returns the ID of the action set, adding it if it is new
+    uint32_t ActionSet(const action_set& actions);
+};
+
+class CompactDrag {
+public:
+    static constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+
+    struct node {
+        uint32_t left = kNone, right = kNone;   // Children, kNone for leaves
+        uint32_t actions = kNone;               // Interned action set of a leaf
+        uint32_t next = kNone;                  // Next tree of a leaf, kNone stands for std::numeric_limits<size_t>::max()
+        uint16_t condition = 0;                 // condition_name ID of a non-leaf node
+
+        bool isleaf() const { return left == kNone; }
+    };
+
+    std::vector<node> nodes_;
+    std::vector<uint32_t> roots_;
+    std::shared_ptr<drag_symbols> symbols_;
+
+    explicit CompactDrag(std::shared_ptr<drag_symbols> symbols = nullptr);
+
+    /** @brief Converts a BinaryDrag, preserving the sharing of its nodes. Only the nodes
+    reachable from the roots are converted. */
+    explicit CompactDrag(const BinaryDrag<conact>& bd, std::shared_ptr<drag_symbols> symbols = nullptr);
+
+    /** @brief Converts back to the pointer representation */
+    BinaryDrag<conact> ToBinaryDrag() const;
+
+    uint32_t AddLeaf(const action_set& actions, size_t next);
+    // Children must already be in the drag
+    uint32_t AddNode(condition_name condition, uint32_t left, uint32_t right);
+
+    condition_name Condition(uint32_t n) const { return condition_name::FromId(nodes_[n].condition); }
+    const action_set& Actions(uint32_t n) const { return symbols_->action_sets_[nodes_[n].actions]; }
+    size_t Next(uint32_t n) const { return nodes_[n].next == kNone ? std::numeric_limits<size_t>::max() : nodes_[n].next; }
+
+    /** @brief Number of unique non-leaf nodes and leaves reachable from the roots, as
+    computed by BinaryDragStatistics */
+    size_t Nodes() const;
+    size_t Leaves() const;
+
+    /** @brief Checks if the (sub)trees rooted in a and b are equal, see EqualTrees() */
+    bool EqualTrees(uint32_t a, uint32_t b) const;
+
+    /** @brief Merges equal subtrees and drops the nodes not reachable from the roots, in
+    linear time */
+    void RemoveEqualSubtrees();
+};
+
+#endif // !GRAPHGEN_COMPACT_DRAG_H_
@@ -105,6 +105,9 @@ void intersect_leaves(BinaryDrag<conact>::node* n1, BinaryDrag<conact>::node* n2
 
 // Checks if two (sub)trees 'n1' and 'n2' are equal
 bool EqualTrees(const BinaryDrag<conact>::node* n1, const BinaryDrag<conact>::node* n2) {
+    // Shared subtrees (e.g., of hash-consed drags) are equal without exploring them
+    if (n1 == n2)
+        return true;
     if (n1->data != n2->data)
         return false;
 
@@ -10,23 +10,102 @@
 #include <string>
 #include <vector>
 #include <bitset>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
 
 
 using uint = uint32_t;
 
+/** @brief Name of a condition, interned in a process-wide table.
+
+Conditions are stored and compared as small integer IDs, so that the passes working on
+drags never hash or compare strings. The name is only needed by the output and code
+generators, and it can be obtained with str() or by implicit conversion to std::string.
+IDs are assigned in order of first use, and rule_set::AddCondition() interns the conditions
+of a rule set in their order. ID 0 is the empty name.
+*/
+class condition_name {
+    uint id_ = 0;
+
+    struct table {
+        std::mutex mutex_;
+        std::deque<std::string> names_{ "" }; // References to the names are never invalidated
+        std::unordered_map<std::string, uint> ids_{ { "", 0 } };
+    };
+
+    static table& Table() {
+        static table t;
+        return t;
+    }
+
+public:
+    condition_name() {}
+    condition_name(const std::string& name) : id_{ Intern(name) } {}
+    condition_name(const char* name) : condition_name(std::string(name)) {}
+
+    /** @brief Returns the ID of name, adding it to the table if it is new */
+    static uint Intern(const std::string& name) {
+        table& t = Table();
+        std::lock_guard<std::mutex> lock(t.mutex_);
+        auto it = t.ids_.find(name);
+        if (it != t.ids_.end()) {
+            return it->second;
+        }
+        t.names_.push_back(name);
+        return t.ids_[name] = static_cast<uint>(t.names_.size() - 1);
+    }
+
+    /** @brief Returns the name associated to an ID */
+    static const std::string& Name(uint id) {
+        table& t = Table();
+        std::lock_guard<std::mutex> lock(t.mutex_);
+        return t.names_[id];
+    }
+
+    /** @brief Returns the condition with the given ID, which must have been returned by Intern() */
+    static condition_name FromId(uint id) {
+        condition_name c;
+        c.id_ = id;
+        return c;
+    }
+
+    uint id() const { return id_; }
+    const std::string& str() const { return Name(id_); }
+    operator const std::string&() const { return str(); }
+
+    bool operator==(const condition_name& other) const { return id_ == other.id_; }
+    bool operator!=(const condition_name& other) const { return id_ != other.id_; }
+    // Orders by ID, not by name
+    bool operator<(const condition_name& other) const { return id_ < other.id_; }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const condition_name& c) {
+    return os << c.str();
+}
+
+template<>
+struct std::hash<condition_name> {
+    size_t operator()(const condition_name& c) const {
+        return std::hash<uint>()(c.id());
+    }
+};
+
 // Condition or action
 struct conact {
     enum class type { CONDITION, ACTION };
 
     type t;
     // CONDITION
-    std::string condition;
+    condition_name condition;
     // ACTION
     std::bitset<131/*CTBE needs 131 bits*/> action = 0; // List of actions (bitmapped)
     size_t next = 0;
 
     conact() {}
-    conact(std::string c) : t(type::CONDITION), condition(std::move(c)) {}
+    conact(condition_name c) : t(type::CONDITION), condition(c) {}
     conact(uint a, uint n) : t(type::ACTION), action(a), next(n) {}
 
     std::vector<uint> actions() const {
@@ -71,5 +150,17 @@ struct conact {
     }
 };
 
+// Hash consistent with conact::operator==, used by hash-consed BinaryDrag
+template<>
+struct std::hash<conact> {
+    size_t operator()(const conact& c) const {
+        if (c.t == conact::type::CONDITION) {
+            return std::hash<condition_name>()(c.condition);
+        }
+        size_t h = std::hash<decltype(c.action)>()(c.action);
+        return h ^ (std::hash<size_t>()(c.next) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2));
+    }
+};
+
 #endif // !GRAPHGEN_CONDITION_ACTION_H_
 
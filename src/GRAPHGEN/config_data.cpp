@@ -104,6 +104,63 @@ ConfigData::ConfigData(string &algorithm_name, const string &mask_name,
     cout << "WARNING: missing output file format, 'pdf' will be used.\n";
   }
 
+  if (config["frequencies"]) {
+    const auto &freq = config["frequencies"];
+    if (freq["queue_depth"]) {
+      frequencies_queue_depth_ = max(1u, freq["queue_depth"].as<unsigned>());
+    }
+    if (freq["read_threads"]) {
+      frequencies_read_threads_ = max(1u, freq["read_threads"].as<unsigned>());
+    }
+    if (freq["decode_threads"]) {
+      frequencies_decode_threads_ = freq["decode_threads"].as<unsigned>();
+    }
+    if (freq["kernel"]) {
+      frequencies_kernel_ = freq["kernel"].as<string>();
+    }
+    if (freq["validate"]) {
+      frequencies_validate_ = freq["validate"].as<bool>();
+    }
+    if (const auto &sampling = freq["sampling"]) {
+      if (sampling["images"]) {
+        frequencies_sampling_images_ =
+            clamp(sampling["images"].as<double>(), 0., 1.);
+      }
+      if (sampling["rows"]) {
+        frequencies_sampling_rows_ =
+            clamp(sampling["rows"].as<double>(), 0., 1.);
+      }
+      if (sampling["seed"]) {
+        frequencies_sampling_seed_ =
+            sampling["seed"].as<unsigned long long>();
+      }
+      if (sampling["bootstrap"]) {
+        frequencies_bootstrap_ = sampling["bootstrap"].as<unsigned>();
+      }
+      if (sampling["check_odt"]) {
+        frequencies_bootstrap_odt_ = sampling["check_odt"].as<bool>();
+      }
+    }
+  }
+
+  if (const auto &synthetic = config["synthetic"]) {
+    if (synthetic["seed"]) {
+      synthetic_seed_ = synthetic["seed"].as<unsigned long long>();
+    }
+    if (synthetic["images"]) {
+      synthetic_images_ = max(1u, synthetic["images"].as<unsigned>());
+    }
+    if (synthetic["width"]) {
+      synthetic_width_ = clamp(synthetic["width"].as<unsigned>(), 1u, 1u << 15);
+    }
+    if (synthetic["height"]) {
+      synthetic_height_ = clamp(synthetic["height"].as<unsigned>(), 1u, 1u << 15);
+    }
+    if (synthetic["depth"]) {
+      synthetic_depth_ = clamp(synthetic["depth"].as<unsigned>(), 1u, 1u << 12);
+    }
+  }
+
   if (config["force_odt_generation"]) {
     force_odt_generation_ = config["force_odt_generation"].as<bool>();
   }
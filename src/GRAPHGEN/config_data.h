@@ -7,6 +7,7 @@
 #ifndef GRAPGHSGEN_CONFIG_DATA_H_
 #define GRAPGHSGEN_CONFIG_DATA_H_
 
+#include <algorithm>
 #include <filesystem>
 
 /** @brief This class stores the configuration data loaded from file. All data
@@ -52,6 +53,7 @@ struct ConfigData {
   std::filesystem::path forestcode_path_;
   std::string forestlabels_suffix_ = "_forest_labels.rs";
   std::filesystem::path forestlabels_path_;
+  std::string forestprofile_suffix_ = "_forest_profile.yaml";
 
   std::string treedagcode_suffix_ = "_tree_dag_code.inc.h";
   std::filesystem::path treedagcode_path_;
@@ -70,6 +72,30 @@ struct ConfigData {
   std::string frequencies_local_path_ = "frequencies";
   std::filesystem::path frequencies_path_;
   std::string frequencies_suffix_ = ".bin";
+  // Frequencies pipeline: depth of the queues between stages and number of
+  // reader/decoder threads (0 decoders means hardware concurrency)
+  unsigned frequencies_queue_depth_ = 16;
+  unsigned frequencies_read_threads_ = 1;
+  unsigned frequencies_decode_threads_ = 0;
+  // Pattern counting kernel ("auto", "scalar", or "avx2"), and whether its
+  // results are checked against the reference counter
+  std::string frequencies_kernel_ = "auto";
+  bool frequencies_validate_ = false;
+  // Frequencies sampling: fraction of images and of mask rows counted, seed, number
+  // of bootstrap replicates, and whether the ODT is generated on every replicate
+  double frequencies_sampling_images_ = 1.;
+  double frequencies_sampling_rows_ = 1.;
+  unsigned long long frequencies_sampling_seed_ = 0;
+  unsigned frequencies_bootstrap_ = 0;
+  bool frequencies_bootstrap_odt_ = false;
+
+  // Synthetic datasets: seed, number of images (or volumes) of each dataset,
+  // and their size (depth only applies to volumes)
+  unsigned long long synthetic_seed_ = 0;
+  unsigned synthetic_images_ = 20;
+  unsigned synthetic_width_ = 512;
+  unsigned synthetic_height_ = 512;
+  unsigned synthetic_depth_ = 64;
 
   // CTBE Ruleset path
   std::filesystem::path ctbe_rstable_path_;
@@ -111,6 +137,12 @@ struct ConfigData {
            std::filesystem::path(algorithm_name_ + forestlabels_suffix_);
   }
 
+  // Forest profile (see forest_profile.h)
+  std::filesystem::path GetForestProfilePath() const {
+    return algorithm_output_path_ /
+           std::filesystem::path(algorithm_name_ + forestprofile_suffix_);
+  }
+
   // Frequencies cache
   std::filesystem::path
   GetFrequenciesPath(const std::string &datasets_name) const {
@@ -141,12 +173,20 @@ struct ConfigData {
     return dataset_names;
   }
 
-  // This serves to use a special algorithm name when using frequencies
+  // This serves to use a special algorithm name when using frequencies.
+  // Dataset names may contain folders (e.g. "synthetic/blobs"), which cannot
+  // appear in file names.
   void UpdateAlgoNameWithDatasets() {
-    algorithm_name_ += "_" + GetDatasetsString("-");
+    std::string datasets = GetDatasetsString("-");
+    std::replace(datasets.begin(), datasets.end(), '/', '_');
+    algorithm_name_ += "_" + datasets;
   }
 
   void SetDescription(std::string description) { description_ = description; }
+
+  bool FrequenciesSampling() const {
+    return frequencies_sampling_images_ < 1. || frequencies_sampling_rows_ < 1.;
+  }
 };
 
 #endif // GRAPGHSGEN_CONFIG_DATA_H_
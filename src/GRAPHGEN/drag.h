@@ -16,6 +16,7 @@
 #include <istream>
 #include <vector>
 
+#include "node_arena.h"
 
 /** @brief A BinaryDrag is the GRAPHGEN implementation of a Binary Directed Rooted Acyclic Graph (DRAG in short)
 
@@ -44,15 +45,55 @@ public:
         }
     };
 
-    /** @brief Vector of unique pointers to BinaryDrag nodes. This is useful to automatically free 
-    the memory of the BinaryDrag, without requiring a recursive exploration of its structure*/
-    std::vector<std::unique_ptr<node>> nodes_;
+    /** @brief Arena which owns the BinaryDrag nodes. This is useful to automatically free 
+    the memory of the BinaryDrag, without requiring a recursive exploration of its structure.
+    Iterating over it gives the addresses of all the nodes ever created, reachable or not. */
+    node_arena<node> nodes_;
 
-    /** @brief Creates and returns a new node updating the nodes_ vector */
+    /** @brief Creates and returns a new node allocated from the nodes_ arena.
+
+    When hash-consing is enabled (see SetHashConsing()) and the node is created with
+    its data (and children), an existing node with the same data and the same children
+    is returned instead, if any. Nodes created empty are never shared.
+    */
     template<typename... Args>
     node* make_node(Args&&... args) {
-        nodes_.emplace_back(std::make_unique<node>(std::forward<Args>(args)...));
-        return nodes_.back().get();
+        if constexpr (sizeof...(Args) > 0) {
+            if (hash_consing_) {
+                node probe(std::forward<Args>(args)...);
+                size_t h = NodeHash(probe);
+                auto range = unique_.equal_range(h);
+                for (auto it = range.first; it != range.second; ++it) {
+                    // Nodes may have been modified after their creation, so their current content is checked
+                    const node* c = it->second;
+                    if (c->left == probe.left && c->right == probe.right && c->data == probe.data) {
+                        return it->second;
+                    }
+                }
+                node* n = nodes_.make(std::move(probe));
+                unique_.emplace(h, n);
+                return n;
+            }
+        }
+        return nodes_.make(std::forward<Args>(args)...);
+    }
+
+    /** @brief Enables or disables hash-consing of the nodes created by make_node().
+
+    With hash-consing enabled, building a drag bottom-up gives a drag where equal
+    subtrees are always the same node, i.e., what RemoveEqualSubtrees() would produce.
+    The caller must then avoid modifying nodes in ways that are not valid for every
+    parent sharing them (e.g., numbering the leaves). Disabling it drops the table.
+    */
+    void SetHashConsing(bool enabled) {
+        hash_consing_ = enabled;
+        if (!enabled) {
+            unique_.clear();
+        }
+    }
+
+    bool HashConsing() const {
+        return hash_consing_;
     }
 
     std::vector<node *> roots_;
@@ -72,39 +113,51 @@ public:
         using std::swap;
         swap(bd1.roots_, bd2.roots_);
         swap(bd1.nodes_, bd2.nodes_);
+        swap(bd1.hash_consing_, bd2.hash_consing_);
+        swap(bd1.unique_, bd2.unique_);
     }
 
     /** @brief Recursive function to copy a BinaryDrag.
     
     This member function is also required by the copy constructor.
 
+    @param[in] bd The BinaryDrag which n belongs to
     @param[in] n The node address of the BinaryDrag from which start the recursive copy
-    @param[in,out] copies Maps every node address to be copied with its copy address.
+    @param[in,out] copies Maps the index of every node to be copied (see node_arena::index_of) with its copy address.
 
     @return Root address of the new tree.
     */
-    node *MakeCopyRecursive(node* n, std::unordered_map<node*, node*>& copies) {
+    node *MakeCopyRecursive(const BinaryDrag& bd, node* n, std::vector<node*>& copies) {
         if (n == nullptr)
             return nullptr;
 
-        if (!copies[n]) {
-            node *nn = make_node();
-            nn->data = n->data;
-            nn->left = MakeCopyRecursive(n->left, copies);
-            nn->right = MakeCopyRecursive(n->right, copies);
-            return copies[n] = nn;
+        node*& copy = copies[bd.nodes_.index_of(n)];
+        if (!copy) {
+            if (hash_consing_) {
+                // Children are copied first, so that the copy stays maximally shared
+                node* l = MakeCopyRecursive(bd, n->left, copies);
+                node* r = MakeCopyRecursive(bd, n->right, copies);
+                copy = make_node(n->data, l, r);
+            }
+            else {
+                node *nn = make_node(n->data);
+                nn->left = MakeCopyRecursive(bd, n->left, copies);
+                nn->right = MakeCopyRecursive(bd, n->right, copies);
+                copy = nn;
+            }
         }
-        return copies[n];
+        return copy;
     }
 
     /** @brief Empty constructor */
     BinaryDrag() {}
 
-    /** @brief Copy constructor */
-    BinaryDrag(const BinaryDrag& bd) {
-        std::unordered_map<node*, node*> copies;
+    /** @brief Copy constructor. Only the nodes reachable from the roots are copied, in a single slab. */
+    BinaryDrag(const BinaryDrag& bd) : hash_consing_{ bd.hash_consing_ } {
+        std::vector<node*> copies(bd.nodes_.size(), nullptr);
+        nodes_.reserve(bd.nodes_.size());
         for (const auto& x : bd.roots_) {
-            roots_.push_back(MakeCopyRecursive(x, copies));
+            roots_.push_back(MakeCopyRecursive(bd, x, copies));
         }
         /*for (const auto& n : bd.nodes_) {
             auto& nn = copies[n.get()];
@@ -115,10 +168,11 @@ public:
     }
 
     /** @brief Special copy constructor that allows to track where the nodes in a tree have been copied to */
-    BinaryDrag(const BinaryDrag& bd, std::vector<node*>& tracked_nodes) { 
-        std::unordered_map<node*, node*> copies;
+    BinaryDrag(const BinaryDrag& bd, std::vector<node*>& tracked_nodes) : hash_consing_{ bd.hash_consing_ } {
+        std::vector<node*> copies(bd.nodes_.size(), nullptr);
+        nodes_.reserve(bd.nodes_.size());
         for (const auto& x : bd.roots_) {
-            roots_.push_back(MakeCopyRecursive(x, copies));
+            roots_.push_back(MakeCopyRecursive(bd, x, copies));
         }
         /*for (const auto& n : bd.nodes_) {
             auto& nn = copies[n.get()];
@@ -127,7 +181,7 @@ public:
             }
         }*/
         for (auto& n : tracked_nodes) {
-            n = copies[n];
+            n = n ? copies[bd.nodes_.index_of(n)] : nullptr;
         }
     }
 
@@ -146,6 +200,161 @@ public:
         roots_.push_back(make_node());
         return roots_.back();
     }
+
+    /** @brief Order in which Compact() lays out the surviving nodes */
+    enum class CompactOrder {
+        CREATION,       /**< @brief Nodes keep their creation order */
+        DEPTH_FIRST,    /**< @brief Pre-order visit from the roots, as done by the copy constructor */
+        BREADTH_FIRST,  /**< @brief Level by level from the roots */
+    };
+
+    /** @brief Frees the nodes which are not reachable from the roots.
+
+    Passes which relink pointers (RemoveEqualSubtrees, MergeLeaves, RemoveTrees, ...) leave the
+    unreferenced nodes in nodes_ until the drag is destroyed. Compact() moves the reachable nodes
+    into a new arena, laid out in the specified order, and releases the old one. All the pointers
+    to nodes held outside of the BinaryDrag (but roots_) are invalidated, unless nothing is freed
+    and the order is CREATION, in which case the BinaryDrag is left untouched.
+
+    With hash-consing enabled, equal nodes (e.g., made equal by modifications in place) are
+    merged first, so that the drag is maximally shared again.
+
+    @param[in] order Layout of the surviving nodes in the new arena.
+
+    @return Number of nodes freed.
+    */
+    size_t Compact(CompactOrder order = CompactOrder::DEPTH_FIRST) {
+        if (hash_consing_) {
+            MergeEqualNodes();
+        }
+
+        std::vector<char> reached(nodes_.size(), 0);
+        std::vector<node*> alive;
+        auto reach = [&](node* n) {
+            if (n == nullptr) {
+                return false;
+            }
+            char& r = reached[nodes_.index_of(n)];
+            if (r) {
+                return false;
+            }
+            r = 1;
+            return true;
+        };
+
+        if (order == CompactOrder::BREADTH_FIRST) {
+            for (node* r : roots_) {
+                if (reach(r)) {
+                    alive.push_back(r);
+                }
+            }
+            for (size_t i = 0; i < alive.size(); ++i) {
+                for (node* c : { alive[i]->left, alive[i]->right }) {
+                    if (reach(c)) {
+                        alive.push_back(c);
+                    }
+                }
+            }
+        }
+        else {
+            std::vector<node*> stack;
+            for (auto it = roots_.rbegin(); it != roots_.rend(); ++it) {
+                stack.push_back(*it);
+            }
+            while (!stack.empty()) {
+                node* n = stack.back();
+                stack.pop_back();
+                if (reach(n)) {
+                    alive.push_back(n);
+                    stack.push_back(n->right);
+                    stack.push_back(n->left);
+                }
+            }
+            if (order == CompactOrder::CREATION) {
+                if (alive.size() == nodes_.size()) {
+                    return 0;
+                }
+                alive.clear();
+                for (node* n : nodes_) {
+                    if (reached[nodes_.index_of(n)]) {
+                        alive.push_back(n);
+                    }
+                }
+            }
+        }
+
+        // Nodes are moved first and linked afterwards, since children may come before or after their parents
+        node_arena<node> arena;
+        arena.reserve(alive.size());
+        std::vector<node*> moved(nodes_.size(), nullptr);
+        for (node* n : alive) {
+            moved[nodes_.index_of(n)] = arena.make(std::move(n->data));
+        }
+        auto relink = [&](node* n) { return n ? moved[nodes_.index_of(n)] : nullptr; };
+        for (node* n : alive) {
+            node* m = moved[nodes_.index_of(n)];
+            m->left = relink(n->left);
+            m->right = relink(n->right);
+        }
+        for (node*& r : roots_) {
+            r = relink(r);
+        }
+
+        size_t freed = nodes_.size() - alive.size();
+        nodes_ = std::move(arena);
+        if (hash_consing_) {
+            unique_.clear();
+            for (node* n : nodes_) {
+                unique_.emplace(NodeHash(*n), n);
+            }
+        }
+        return freed;
+    }
+
+private:
+    bool hash_consing_ = false;
+    // Nodes created by make_node() while hash-consing, by NodeHash() of their content at creation
+    std::unordered_multimap<size_t, node*> unique_;
+
+    // Relinks the nodes reachable from the roots to a single representative of each group of
+    // equal nodes, children first, and rebuilds unique_ with the representatives
+    void MergeEqualNodes() {
+        unique_.clear();
+        std::vector<node*> rep(nodes_.size(), nullptr);
+        auto merge = [&](auto&& self, node* n) -> node* {
+            if (n == nullptr) {
+                return nullptr;
+            }
+            node*& r = rep[nodes_.index_of(n)];
+            if (!r) {
+                n->left = self(self, n->left);
+                n->right = self(self, n->right);
+                size_t h = NodeHash(*n);
+                auto range = unique_.equal_range(h);
+                for (auto it = range.first; it != range.second && !r; ++it) {
+                    const node* c = it->second;
+                    if (c->left == n->left && c->right == n->right && c->data == n->data) {
+                        r = it->second;
+                    }
+                }
+                if (!r) {
+                    unique_.emplace(h, n);
+                    r = n;
+                }
+            }
+            return r;
+        };
+        for (node*& r : roots_) {
+            r = merge(merge, r);
+        }
+    }
+
+    static size_t NodeHash(const node& n) {
+        size_t h = std::hash<T>()(n.data);
+        h ^= std::hash<const node*>()(n.left) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+        h ^= std::hash<const node*>()(n.right) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+        return h;
+    }
 };
 
 //class ConactBinaryDrag : BinaryDrag<conact> {
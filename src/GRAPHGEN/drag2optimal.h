@@ -17,7 +17,8 @@ void Dag2DagUsingIdenties(BinaryDrag<conact>& t);
 void Dag2DagUsingEquivalences(BinaryDrag<conact>& t, bool considering_leaves = true);
 
 // Converts a tree into dag minimizing the number of nodes (Note: this is "necessary" when the leaves of a tree contain multiple actions)
-// USES NUMBER OF NODES TO PICK THE OPTIMAL DAG
+// USES NUMBER OF NODES TO PICK THE OPTIMAL DAG. The combinations of actions are explored by branch
+// and bound, see SolveOptimalDrag()
 void Dag2OptimalDag(BinaryDrag<conact>& t);
 
 #endif // !GRAPHGEN_DRAG2OPTIMAL_H_
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include <unordered_set>
 
 #include "collect_drag_stats.h"
+#include "drag_journal.h"
 #include "drag_statistics.h"
 #include "output_generator.h"
 #include "remove_equal_subtrees.h"
@@ -331,17 +332,20 @@ private:
     best_leaves_ = std::numeric_limits<size_t>::max();
   }
 
-  // This class perform the merge of equivalent trees updating links
+  // This class perform the merge of equivalent trees updating links. Every
+  // node is saved into the journal before being modified.
   struct MergeEquivalentTreesAndUpdate {
     std::unordered_set<BinaryDrag<conact>::node *> visited_;
     std::unordered_map<BinaryDrag<conact>::node *,
                        std::vector<BinaryDrag<conact>::node *>> &parents_;
+    DragJournal<conact> &journal_;
 
     MergeEquivalentTreesAndUpdate(
         BinaryDrag<conact>::node *a, BinaryDrag<conact>::node *b,
         std::unordered_map<BinaryDrag<conact>::node *,
-                           std::vector<BinaryDrag<conact>::node *>> &parents)
-        : parents_{parents} {
+                           std::vector<BinaryDrag<conact>::node *>> &parents,
+        DragJournal<conact> &journal)
+        : parents_{parents}, journal_{journal} {
       MergeEquivalentTreesAndUpdateRec(a, b);
     }
 
@@ -353,6 +357,7 @@ private:
       visited_.insert(a);
 
       for (auto &x : parents_[b]) {
+        journal_.Save(x);
         if (x->left == b)
           x->left = a;
         else
@@ -360,6 +365,7 @@ private:
       }
 
       if (a->isleaf()) {
+        journal_.Save(a);
         a->data.action &= b->data.action;
       } else {
         MergeEquivalentTreesAndUpdateRec(a->left, b->left);
@@ -390,7 +396,7 @@ private:
 
     // For each subtree (with or without considering leaves) ...
     for (size_t i = 0; i < trees.size();) {
-      if (ignore_leaves && trees[i].conditions_ == ".") {
+      if (ignore_leaves && trees[i].n_->isleaf()) {
         trees.erase(begin(trees) + i);
         continue;
       }
@@ -432,32 +438,26 @@ private:
           // Here an equivalence is found!
           no_eq = false;
 
-          // Then we need to copy the original (entire) tree
-          // keeping track of some nodes. Indeed, to perform
-          // the link update, we need to know the pointers to
-          // the roots of the equivalent subtrees after the
-          // copy.
-          std::vector<BinaryDrag<conact>::node *> tracked_nodes{trees[i].n_,
-                                                                trees[j].n_};
-          BinaryDrag<conact> bd_copy(bd, tracked_nodes);
-
-          // Re-calculate subtrees/node statistics over the tree
-          // copy since pointers to nodes are changed.
-          CollectDragStatistics cds(bd_copy);
+          // The candidate is obtained modifying bd in place: it shares all
+          // the nodes with bd, and the journal saves the few nodes which are
+          // modified, so that bd is restored when the candidate has been
+          // explored. Since bd is unchanged at this point, the parents
+          // collected above are still valid and node addresses are stable.
+          DragJournal<conact> journal(bd);
 
           // Perform the merge of equivalent trees updating links
-          MergeEquivalentTreesAndUpdate(tracked_nodes[0], tracked_nodes[1],
-                                        cds.parents_);
+          MergeEquivalentTreesAndUpdate(trees[i].n_, trees[j].n_, cds.parents_,
+                                        journal);
 
           // Remove equal subtrees inside a BinaryDrag. Is this really
           // necessary here? Maybe it isn't but performing this operation
           // here can improve the efficiency of the compression in case
           // there are actually equal sub-trees.
-          RemoveEqualSubtrees{bd_copy};
+          RemoveEqualSubtrees{bd, &journal};
 
           // Recursively call the compression function on the current
           // resulting tree
-          FastDragOptimizerRec(bd_copy, flags);
+          FastDragOptimizerRec(bd, flags);
         }
       }
     }
@@ -481,19 +481,21 @@ private:
         changes_ = true;
         iterations_left_ = iterations_max_;
 
-        // ... compress the leaves of the current optimal binary drag
-        MergeSpecialLeaves{bd};
-        MergeLeaves{bd};
+        // ... compress the leaves of the current optimal binary drag, which
+        // is copied since bd is restored by the caller
+        BinaryDrag<conact> best = bd;
+        MergeSpecialLeaves{best};
+        MergeLeaves{best};
 
         // ... and finally update class attributes accordingly
-        BinaryDragStatistics bds(bd);
+        BinaryDragStatistics bds(best);
         best_nodes_ = bds.Nodes();
         best_leaves_ = bds.Leaves();
-        best_bd_ = bd;
+        best_bd_ = std::move(best);
 
         // ... save the current tree if needed
         if (save_intermediate_results) {
-          DrawDagOnFile("BestDrag" + zerostr(progress_counter_, 10), bd);
+          DrawDagOnFile("BestDrag" + zerostr(progress_counter_, 10), best_bd_);
         }
 
         // ... print status if needed
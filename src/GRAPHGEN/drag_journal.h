@@ -0,0 +1,64 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_DRAG_JOURNAL_H_
+#define GRAPHGEN_DRAG_JOURNAL_H_
+
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "drag.h"
+
+/** @brief Records the original content of the nodes of a BinaryDrag which are modified
+in place, so that all the modifications can be undone.
+
+This allows to explore a variant of a BinaryDrag (e.g., a candidate of the DragCompressor
+search) without copying it: the variant shares all the nodes with the original drag, and
+only the nodes actually modified are saved, before their first modification. Undo() (or
+the destructor) restores the saved nodes and the roots, so that the BinaryDrag becomes
+exactly the original one again, with the same node addresses.
+
+Journals can be nested, as long as they are undone in reverse order of creation. New
+nodes can be created while a journal is active, but they are not released by Undo().
+*/
+template<typename T>
+class DragJournal {
+    using node = typename BinaryDrag<T>::node;
+
+    BinaryDrag<T>& bd_;
+    std::vector<node*> roots_;
+    std::vector<std::pair<node*, node>> saved_;
+    std::unordered_set<const node*> saved_set_;
+
+public:
+    DragJournal(BinaryDrag<T>& bd) : bd_{ bd }, roots_{ bd.roots_ } {}
+    DragJournal(const DragJournal&) = delete;
+    DragJournal& operator=(const DragJournal&) = delete;
+    ~DragJournal() { Undo(); }
+
+    /** @brief Saves the content of n, if not already saved. It must be called before modifying n. */
+    void Save(node* n) {
+        if (saved_set_.insert(n).second) {
+            saved_.emplace_back(n, *n);
+        }
+    }
+
+    /** @brief Returns the number of nodes saved so far */
+    size_t Size() const { return saved_.size(); }
+
+    /** @brief Restores the saved nodes and the roots, and empties the journal */
+    void Undo() {
+        for (auto it = saved_.rbegin(); it != saved_.rend(); ++it) {
+            *it->first = std::move(it->second);
+        }
+        saved_.clear();
+        saved_set_.clear();
+        bd_.roots_ = roots_;
+    }
+};
+
+#endif // !GRAPHGEN_DRAG_JOURNAL_H_
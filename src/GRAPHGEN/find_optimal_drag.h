@@ -7,102 +7,41 @@
 #ifndef GRAPHGEN_FIND_OPTIMAL_DRAG_H_
 #define GRAPHGEN_FIND_OPTIMAL_DRAG_H_
 
-#include <bitset>
 #include <iostream>
-#include <iomanip>
-#include <unordered_set>
-#include <mutex>
-#include <thread>
-
-#include "pool.h"
 
 #include "conact_tree.h"
-#include "remove_equal_subtrees.h"
+#include "optimal_drag_solver.h"
 
+// Finds the combination of actions of the leaves with multiple actions which gives the drag with
+// the minimum number of nodes (and leaves). The combinations are explored in parallel by branch
+// and bound, see SolveOptimalDrag(): workers take whole chunks of the combinations and modify their
+// own copy of the search state, and combinations which cannot improve the best drag found by any
+// worker are pruned instead of being generated.
 struct FindOptimalDrag {
-    std::vector<BinaryDrag<conact>::node*> lma_; // leaves with multiple actions
-    std::unordered_set<BinaryDrag<conact>::node*> visited_; // utility set to remember already visited nodes
     BinaryDrag<conact> t_;
 
     BinaryDrag<conact> best_tree_;
-    uint counter_ = 0;
+    uint64_t counter_ = 0; // explored (partial) combinations
     uint best_nodes_ = std::numeric_limits<uint>::max();
     uint best_leaves_ = std::numeric_limits<uint>::max();
 
-    std::mutex best_tree_mutex_;
-    thread_pool *pool_ = nullptr;
-
-    FindOptimalDrag(BinaryDrag<conact> t) : t_{ std::move(t) } {
-        GetLeavesWithMultipleActionsRec(t_.GetRoot());
-    }
-
-    // This method fill the lma_ variable with all the leaves that have multiple actions. This
-    // vector (lma_) will be used by the backtrack algorithm to generate all the possible trees 
-    // (i.e all the possible trees with one action per leaf).
-    void GetLeavesWithMultipleActionsRec(BinaryDrag<conact>::node* n) {
-        if (visited_.count(n) > 0) {
-            return;
-        }
-        visited_.insert(n);
-        if (n->isleaf()) {
-            if (n->data.action.count() > 1) {
-                lma_.push_back(n);
-            }
-            return;
-        }
-        GetLeavesWithMultipleActionsRec(n->left);
-        GetLeavesWithMultipleActionsRec(n->right);
-    }
-
-    void ReduceAndUpdateBest(BinaryDrag<conact> t)
-    {
-        //RemoveEqualSubtrees sc(t.GetRoot()); TODO originale
-        RemoveEqualSubtrees sc(t);
-
-        std::lock_guard<std::mutex> lock(best_tree_mutex_);
-        if (best_nodes_ > sc.nodes_ || (best_nodes_ == sc.nodes_ && best_leaves_ > sc.leaves_)) {
-            best_nodes_ = sc.nodes_;
-            best_leaves_ = sc.leaves_;
-            best_tree_ = std::move(t);
-            std::cout << "\rbest_nodes_ = " << best_nodes_ << " - best_leaves_ = " << best_leaves_ << "\n";
-        }
-
-        if (counter_ == 0) {
-            std::cout << "  0%";
-        }
-
-        if (++counter_ % 79626 == 0) {
-            std::cout << "\r" << std::setfill(' ') << std::setw(3) << counter_ / 79626 << "%";
-        }
-    }
+    FindOptimalDrag(BinaryDrag<conact> t) : t_{ std::move(t) } {}
 
-    void GenerateAllTreesRec(int cur_leaf)
+    // threads = 0 uses one thread per hardware thread. The result does not depend on the number
+    // of threads.
+    optimal_drag_result GenerateAllTrees(uint64_t max_explored = 0, unsigned threads = 0)
     {
-        if (cur_leaf == lma_.size()) {
-            // We have a tree without multiple actions
-
-            pool_->enqueue_work(&FindOptimalDrag::ReduceAndUpdateBest, this, t_);
-
-            return;
+        best_tree_ = t_;
+        optimal_drag_result res = SolveOptimalDrag(best_tree_, max_explored, threads);
+        best_nodes_ = static_cast<uint>(res.nodes_);
+        best_leaves_ = static_cast<uint>(res.leaves_);
+        counter_ = res.explored_;
+        std::cout << "best_nodes_ = " << best_nodes_ << " - best_leaves_ = " << best_leaves_;
+        if (!res.optimal_) {
+            std::cout << " - lower bound = " << res.lower_bound_;
         }
-
-        auto action_bs = lma_[cur_leaf]->data.action;
-        auto actions = lma_[cur_leaf]->data.actions(); // vector of actions ("uint")
-
-        for (size_t i = 0; i < actions.size(); ++i) {
-            std::bitset<131/*CTBE needs 131 bits*/> bs;
-            bs.set(actions[i] - 1);
-            lma_[cur_leaf]->data.action = bs;
-            GenerateAllTreesRec(cur_leaf + 1);
-        }
-        lma_[cur_leaf]->data.action = action_bs;
-    }
-
-    void GenerateAllTrees()
-    {
-        pool_ = new thread_pool(8, 8);
-        GenerateAllTreesRec(0);
-        delete pool_;
+        std::cout << "\n";
+        return res;
     }
 };
 
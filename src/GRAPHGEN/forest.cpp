@@ -27,6 +27,11 @@ LineForestHandler::LineForestHandler(const BinaryDrag<conact> &bd,
   // position
   next_tree_.push_back(0);
 
+  // The forests are hash-consed while they are built, so that equal subtrees
+  // are shared as soon as they are created (see BinaryDrag::SetHashConsing).
+  // tmp is not, since its leaves are numbered one by one by InitNextRec().
+  f_.SetHashConsing(true);
+
   // Apply predefined constraints
   BinaryDrag<conact> tmp;
   tmp.AddRoot(Reduce(bd.roots_[0], tmp, initial_constraints));
@@ -64,6 +69,7 @@ LineForestHandler::LineForestHandler(const BinaryDrag<conact> &bd,
   while (RemoveEqualTrees()) {
     RemoveUselessConditions();
   }
+  Compact();
 
   /********************
    *  END LINE TREES  *
@@ -122,6 +128,7 @@ LineForestHandler::LineForestHandler(const BinaryDrag<conact> &bd,
       }
 
       end_forests_.push_back(BinaryDrag<conact>());
+      end_forests_.back().SetHashConsing(true);
 
       for (const auto &t : f_.roots_) {
         end_forests_.back().AddRoot(Reduce(t, end_forests_.back(), end_constr));
@@ -144,7 +151,7 @@ LineForestHandler::LineForestHandler(const BinaryDrag<conact> &bd,
     // trees must share the same fake next to be able to delete equal (useless)
     // end trees.
     for (auto &f : end_forests_) { // For each end forest
-      for (auto &n : f.nodes_) {   // For each node of the forest
+      for (auto n : f.nodes_) {    // For each node of the forest
         if (n->isleaf()) {
           n->data.next = numeric_limits<size_t>::max();
         }
@@ -156,6 +163,30 @@ LineForestHandler::LineForestHandler(const BinaryDrag<conact> &bd,
   while (RemoveEqualEndTrees()) {
     RemoveEndTreesUselessConditions();
   }
+  // Compact() also shares again the subtrees made equal by the passes above.
+  // Later stages modify nodes in place, so hash-consing stops here.
+  Compact();
+  f_.SetHashConsing(false);
+  for (auto &f : end_forests_) {
+    f.SetHashConsing(false);
+  }
+}
+
+size_t LineForestHandler::AllocatedNodes() const {
+  size_t nodes = f_.nodes_.size();
+  for (const auto &f : end_forests_) {
+    nodes += f.nodes_.size();
+  }
+  return nodes;
+}
+
+size_t LineForestHandler::Compact() {
+  peak_nodes_ = max(peak_nodes_, AllocatedNodes());
+  size_t freed = f_.Compact();
+  for (auto &f : end_forests_) {
+    freed += f.Compact();
+  }
+  return freed;
 }
 
 // void LineForestHandler::RebuildDisjointTrees() {
@@ -251,12 +282,17 @@ bool LineForestHandler::RemoveEquivalentEndTrees() {
   // return RemoveEndTrees(equivalent_trees);
 }
 
-void LineForestHandler::UpdateNext(BinaryDrag<conact>::node *n) {
+void LineForestHandler::UpdateNext(
+    BinaryDrag<conact>::node *n,
+    unordered_set<const BinaryDrag<conact>::node *> &visited) {
+  if (!visited.insert(n).second) {
+    return;
+  }
   if (n->isleaf()) {
     n->data.next = next_tree_[n->data.next];
   } else {
-    UpdateNext(n->left);
-    UpdateNext(n->right);
+    UpdateNext(n->left, visited);
+    UpdateNext(n->right, visited);
   }
 }
 
@@ -326,8 +362,9 @@ bool LineForestHandler::RemoveTrees(
   } else {
     // If we are dealing with main trees then we need to update the
     // id of the next tree because they changed
+    unordered_set<const BinaryDrag<conact>::node *> visited;
     for (auto &r : f.roots_) {
-      UpdateNext(r);
+      UpdateNext(r, visited);
     }
   }
 
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <map>
 #include <numeric>
+#include <unordered_set>
 
 #include "conact_tree.h"
 #include "pixel_set.h"
@@ -43,7 +44,7 @@ struct Equivalences {
     }
 };
 
-using constraints = std::map<std::string, int>;
+using constraints = std::map<condition_name, int>;
 static std::vector<size_t> DEFAULT_VECTOR; // Dummy vector for the default value of DeleteTree member function
 
 /** @brief Generates all the forests needed to handle one line of the image.
@@ -79,10 +80,10 @@ struct LineForestHandler {
                 constraints constrNew = constr;
                 auto ft = eq_.Find(n->data.condition);
                 if (ft)
-                    constrNew[ft] = 0;
+                    constrNew[condition_name(ft)] = 0;
                 CreateReducedTreesRec(n->left, constrNew);
                 if (ft)
-                    constrNew[ft] = 1;
+                    constrNew[condition_name(ft)] = 1;
                 CreateReducedTreesRec(n->right, constrNew);
             }
         }
@@ -97,13 +98,23 @@ struct LineForestHandler {
     std::vector<std::vector<size_t>> end_next_tree_; // This vectors contain the equivalences between end trees
     std::vector<std::vector<size_t>> main_end_tree_mapping_; // This is the mapping between main trees and end trees
 
+    size_t peak_nodes_ = 0; // Highest number of nodes allocated by the forests seen by Compact()
+
     LineForestHandler() {}
     LineForestHandler(const BinaryDrag<conact>& t, const pixel_set& ps, const constraints& initial_constraints = {}); // Initial_constraints are useful to create particular forests such as the first line forest
 
     void RemoveUselessConditions();
     void RemoveEndTreesUselessConditions();
 
-    void UpdateNext(BinaryDrag<conact>::node* n);
+    // Frees the unreachable nodes of the main and end forests (see BinaryDrag::Compact), and returns
+    // their number. It is called at the end of every stage of the forests pipeline.
+    size_t Compact();
+    // Number of nodes currently allocated by the main and end forests, reachable or not
+    size_t AllocatedNodes() const;
+
+    // Updates the next tree of the leaves reachable from n. Visited nodes are skipped, so that
+    // leaves shared by many trees (e.g., by hash-consed forests) are updated only once
+    void UpdateNext(BinaryDrag<conact>::node* n, std::unordered_set<const BinaryDrag<conact>::node*>& visited);
 
     // Removes duplicate trees
     bool RemoveEqualTrees();
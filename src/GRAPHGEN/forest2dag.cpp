@@ -6,58 +6,60 @@
 
 #include "forest2dag.h"
 
-#include <sstream>
-#include <iomanip>
-
 using namespace std;
 
-// Converts a tree into unique string exploiting memoization 
-string Forest2Dag::Tree2String(BinaryDrag<conact>::node* n) {
-	auto it = ps_.find(n);
-	if (it != end(ps_))
+// Computes the structural hash of a tree exploiting memoization
+hash128 Forest2Dag::TreeHash(const BinaryDrag<conact>::node* n) {
+	auto it = ph_.find(n);
+	if (it != end(ph_))
 		return it->second;
 
-	string s;
-	if (n->isleaf()) {
-		//char a_action[sizeof(n->data.action) + 1] = { 0 };
-		//memcpy(a_action, reinterpret_cast<char*>(&n->data.action), sizeof(n->data.action));
-		stringstream ss;
-		ss << setfill('0') << setw(3) << n->data.next;
-		s = n->data.action.to_string() + ss.str();
-	}
+	hash128 h;
+	if (n->isleaf())
+		h = LeafHash(n->data);
 	else
-		s = n->data.condition + Tree2String(n->left) + Tree2String(n->right);
+		h = NodeHash(n->data.condition, TreeHash(n->left), TreeHash(n->right));
 
-	ps_[n] = s;
-	return s;
+	ph_[n] = h;
+	return h;
+}
+
+BinaryDrag<conact>::node* Forest2Dag::Find(const BinaryDrag<conact>::node* n, const hash128& h) const {
+	auto range = hp_.equal_range(h);
+	for (auto it = range.first; it != range.second; ++it) {
+		// Equal hashes are verified, since different trees may collide
+		if (EqualTrees(it->second, n))
+			return it->second;
+	}
+	return nullptr;
 }
 
 // Recursively searches for equal subtrees inside the forest. It starts from a root of the forest
-// and explore its subtrees. For each subtree, if there is an equal subtree (i.e. sp_ hash table
-// contains the tree identifier string) the function updates the link, otherwise it updates the 
+// and explore its subtrees. For each subtree, if there is an equal subtree (i.e. hp_ hash table
+// contains the tree structural hash) the function updates the link, otherwise it updates the 
 // hash table with the "new" subtree. This must be repeated for every root of the forest (see Forest2Dag) 
 void Forest2Dag::FindAndLink(BinaryDrag<conact>::node* n) {
 	if (!n->isleaf()) {
-		auto s = Tree2String(n->left);
+		auto h = TreeHash(n->left);
 
-		auto it = sp_.find(s);
-		if (it == end(sp_)) {
-			sp_[s] = n->left;
+		auto found = Find(n->left, h);
+		if (found == nullptr) {
+			hp_.emplace(h, n->left);
 			FindAndLink(n->left);
 		}
 		else {
-			n->left = it->second;
+			n->left = found;
 		}
 
-		s = Tree2String(n->right);
+		h = TreeHash(n->right);
 
-		it = sp_.find(s);
-		if (it == end(sp_)) {
-			sp_[s] = n->right;
+		found = Find(n->right, h);
+		if (found == nullptr) {
+			hp_.emplace(h, n->right);
 			FindAndLink(n->right);
 		}
 		else {
-			n->right = it->second;
+			n->right = found;
 		}
 	}
 }
@@ -70,16 +72,16 @@ void Forest2Dag::FindAndLink(BinaryDrag<conact>::node* n) {
 //	}
 //
 //	// Clean memoizing data structures
-//	ps_.clear();
-//	sp_.clear();
+//	ph_.clear();
+//	hp_.clear();
 //
 //	// Conversion to DAG for the end forest
 //	for (auto& etg : f_.end_trees_) { // etg -> end trees groups
 //
 //		if (f.separately) {
 //			// Clean memoizing data structures
-//			ps_.clear();
-//			sp_.clear();
+//			ph_.clear();
+//			hp_.clear();
 //		}
 //
 //		for (auto& et : etg) {
@@ -8,18 +8,21 @@
 #define GRAPHGEN_FOREST2DAG_H_
 
 #include <iterator>
-#include <string>
 #include <unordered_map>
 
 #include "forest.h"
+#include "structural_hash.h"
 
 // Converts forest of decision trees into poly-rooted-dag
 struct Forest2Dag {
-	std::unordered_map<BinaryDrag<conact>::node*, std::string> ps_; // pointer -> string
-	std::unordered_map<std::string, BinaryDrag<conact>::node*> sp_; // string -> pointer
+	std::unordered_map<const BinaryDrag<conact>::node*, hash128> ph_; // pointer -> hash
+	std::unordered_multimap<hash128, BinaryDrag<conact>::node*> hp_; // hash -> pointer
 	LineForestHandler& f_;
 
-	std::string Tree2String(BinaryDrag<conact>::node* n);
+	hash128 TreeHash(const BinaryDrag<conact>::node* n);
+
+	// Returns the subtree already found which is equal to n, or nullptr
+	BinaryDrag<conact>::node* Find(const BinaryDrag<conact>::node* n, const hash128& h) const;
 
 	void FindAndLink(BinaryDrag<conact>::node* n);
 
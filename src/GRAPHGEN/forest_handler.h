@@ -240,6 +240,29 @@ public:
            int iterations = -1) {
     for (auto &x : f_) {
       DragCompressor(x.second, iterations, flags);
+      x.second.Compact();
+    }
+    if (flags & DragCompressorFlags::PRINT_STATUS_BAR) {
+      PrintMemoryStats();
+    }
+  }
+
+  /** @brief Displays, for each forests group, the number of nodes currently
+  allocated and the highest number of nodes allocated between two stages of the
+  pipeline (see LineForestHandler::Compact), with the corresponding memory.
+
+  @param[in] os Output stream where to write the statistics. Default value is
+  std::cout.
+  */
+  void PrintMemoryStats(std::ostream &os = std::cout) const {
+    constexpr size_t node_size = sizeof(BinaryDrag<conact>::node);
+    for (const auto &x : f_) {
+      size_t nodes = x.second.AllocatedNodes();
+      size_t peak = std::max(nodes, x.second.peak_nodes_);
+      os << conf.algorithm_name_ << " - " << names.at(x.first)
+         << " forests: " << nodes << " nodes allocated ("
+         << (nodes * node_size + 1023) / 1024 << " KiB), peak " << peak
+         << " nodes (" << (peak * node_size + 1023) / 1024 << " KiB)\n";
     }
   }
 
@@ -0,0 +1,319 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "forest_profile.h"
+
+#include <fstream>
+#include <iostream>
+
+#include "image_frequencies.h"
+#include "image_io.h"
+#include "synthetic_dataset.h"
+
+using namespace std;
+using namespace filesystem;
+
+double forest_profile::RightProbability(const BinaryDrag<conact>::node* n) const {
+    auto it = node_ids_.find(n);
+    if (it == node_ids_.end() || visits_[it->second] == 0) {
+        return 0.5;
+    }
+    return static_cast<double>(right_[it->second]) / visits_[it->second];
+}
+
+namespace {
+
+// Forest flattened into arrays, so that the replay does not need to look up conditions by name
+struct flat_forest {
+    struct flat_node {
+        int condition = -1;     // Index in replayer::conditions_, -1 for leaves
+        size_t left = 0, right = 0;
+        size_t next = 0;
+    };
+    vector<flat_node> nodes_;
+    vector<size_t> roots_;
+};
+
+class replayer {
+    // Conditions are pixels of the mask, read from the image, or extra conditions, whose
+    // value is fixed for a whole replay
+    struct condition {
+        int dx = 0, dy = 0;
+        int extra = -1;
+    };
+    vector<condition> conditions_;
+    map<string, int> condition_ids_;
+    vector<string> extra_;
+    int shift_x_, shift_y_;
+    int min_dy_ = 0, max_dy_ = 0;
+    int border_ = 0;
+
+    struct line_forest {
+        ForestHandlerFlags flag{};
+        const LineForestHandler* lfh = nullptr;
+        line_forest_profile* profile = nullptr;
+        flat_forest main;
+        vector<flat_forest> end;
+    };
+    vector<line_forest> lines_;
+
+    int ConditionId(const string& name) {
+        auto it = condition_ids_.find(name);
+        if (it != condition_ids_.end()) {
+            return it->second;
+        }
+        condition c;
+        c.extra = static_cast<int>(extra_.size());
+        extra_.push_back(name);
+        conditions_.push_back(c);
+        return condition_ids_[name] = static_cast<int>(conditions_.size() - 1);
+    }
+
+    // Numbers nodes in depth-first order, which is also the order used in the saved profile
+    void Flatten(const BinaryDrag<conact>& bd, flat_forest& ff, forest_profile& fp) {
+        auto visit = [&](auto&& self, const BinaryDrag<conact>::node* n) -> size_t {
+            auto it = fp.node_ids_.find(n);
+            if (it != fp.node_ids_.end()) {
+                return it->second;
+            }
+            size_t id = ff.nodes_.size();
+            fp.node_ids_[n] = id;
+            fp.nodes_.push_back(n);
+            ff.nodes_.emplace_back();
+            if (n->isleaf()) {
+                ff.nodes_[id].next = n->data.next;
+            }
+            else {
+                ff.nodes_[id].condition = ConditionId(n->data.condition);
+                size_t left = self(self, n->left);
+                size_t right = self(self, n->right);
+                ff.nodes_[id].left = left;
+                ff.nodes_[id].right = right;
+            }
+            return id;
+        };
+        for (const auto* r : bd.roots_) {
+            ff.roots_.push_back(visit(visit, r));
+        }
+        fp.visits_.assign(ff.nodes_.size(), 0);
+        fp.right_.assign(ff.nodes_.size(), 0);
+        fp.tree_entries_.assign(ff.roots_.size(), 0);
+    }
+
+    // Executes tree t of ff with the mask placed on (r, c), and returns the leaf reached
+    const flat_forest::flat_node& Run(const flat_forest& ff, forest_profile& fp, size_t t, const binary_image& img, int r, int c, unsigned extra_values) const {
+        ++fp.tree_entries_[t];
+        size_t id = ff.roots_[t];
+        while (true) {
+            const auto& n = ff.nodes_[id];
+            ++fp.visits_[id];
+            if (n.condition < 0) {
+                return n;
+            }
+            const condition& cond = conditions_[n.condition];
+            bool value = cond.extra >= 0 ? ((extra_values >> cond.extra) & 1) : img(r + cond.dy, c + cond.dx) != 0;
+            if (value) {
+                ++fp.right_[id];
+                id = n.right;
+            }
+            else {
+                id = n.left;
+            }
+        }
+    }
+
+    // Replays a line as the generated code does: the start tree is executed on the first
+    // column, then the mask moves by shift_x_ and the next tree is taken from the leaf
+    // reached, until the mask crosses the end of the line and an end tree is used.
+    void ReplayLine(line_forest& lf, const binary_image& img, int r, unsigned extra_values) const {
+        const int w = img.cols_;
+        const int end_groups = static_cast<int>(lf.end.size());
+        line_forest_profile& lp = *lf.profile;
+        ++lp.lines_;
+        size_t t = 0;
+        for (int c = 0; c < w; c += shift_x_) {
+            const int out_offset = w - c;
+            if (out_offset <= end_groups) {
+                // End tree, whose pixels with dx >= out_offset are outside the image
+                size_t g = out_offset - 1;
+                Run(lf.end[g], lp.end_[g], lf.lfh->main_end_tree_mapping_[g][t], img, r, c, extra_values);
+                break;
+            }
+            size_t next = Run(lf.main, lp.main_, t, img, r, c, extra_values).next;
+            ++lp.transitions_[{ t, next }];
+            t = next;
+        }
+    }
+
+    // Forest to be used on row r, following the constraints used by ForestHandler
+    line_forest* Select(int r, int rows) {
+        const bool first = r + min_dy_ < 0;
+        const bool last = r + max_dy_ >= rows;
+        auto find = [this](ForestHandlerFlags f) -> line_forest* {
+            for (auto& lf : lines_) {
+                if (lf.flag == f) return &lf;
+            }
+            return nullptr;
+        };
+        line_forest* lf = nullptr;
+        if (first && last) lf = find(ForestHandlerFlags::SINGLE_LINE);
+        if (!lf && first) lf = find(ForestHandlerFlags::FIRST_LINE);
+        if (!lf && last) lf = find(ForestHandlerFlags::LAST_LINE);
+        if (!lf) lf = find(ForestHandlerFlags::CENTER_LINES);
+        return lf;
+    }
+
+public:
+    replayer(const ForestHandler& fh, const pixel_set& ps, forests_profile& profile) : shift_x_{ max(1, ps.GetShiftX()) }, shift_y_{ max(1, static_cast<int>(ps.shifts_[1])) } {
+        for (const auto& p : ps) {
+            condition c;
+            c.dx = p.GetDx();
+            c.dy = p.GetDy();
+            condition_ids_[p.name_] = static_cast<int>(conditions_.size());
+            conditions_.push_back(c);
+            min_dy_ = min(min_dy_, c.dy);
+            max_dy_ = max(max_dy_, c.dy);
+            border_ = max({ border_, abs(c.dx), abs(c.dy) });
+        }
+        for (const auto& x : fh.f_) {
+            line_forest_profile& lp = profile.lines_[x.first];
+            lp.end_.resize(x.second.end_forests_.size());
+            line_forest lf{ x.first, &x.second, &lp, {}, {} };
+            Flatten(x.second.f_, lf.main, lp.main_);
+            lf.end.resize(x.second.end_forests_.size());
+            for (size_t g = 0; g < lf.end.size(); ++g) {
+                Flatten(x.second.end_forests_[g], lf.end[g], lp.end_[g]);
+            }
+            lines_.push_back(move(lf));
+        }
+    }
+
+    int border() const { return border_; }
+    const vector<string>& extra() const { return extra_; }
+
+    void Replay(const binary_image& img) {
+        for (unsigned extra_values = 0; extra_values < (1u << extra_.size()); ++extra_values) {
+            for (int r = 0; r < img.rows_; r += shift_y_) {
+                line_forest* lf = Select(r, img.rows_);
+                if (lf) {
+                    ReplayLine(*lf, img, r, extra_values);
+                }
+            }
+        }
+    }
+};
+
+void SaveForest(YAML::Emitter& out, const forest_profile& fp) {
+    out << YAML::BeginMap;
+    out << YAML::Key << "tree_entries" << YAML::Value << YAML::Flow << fp.tree_entries_;
+    out << YAML::Key << "nodes" << YAML::Value << YAML::BeginSeq;
+    for (size_t id = 0; id < fp.nodes_.size(); ++id) {
+        const auto* n = fp.nodes_[id];
+        out << YAML::Flow << YAML::BeginMap << YAML::Key << "id" << YAML::Value << id;
+        if (n->isleaf()) {
+            out << YAML::Key << "next" << YAML::Value << n->data.next;
+            out << YAML::Key << "visits" << YAML::Value << fp.visits_[id];
+        }
+        else {
+            out << YAML::Key << "condition" << YAML::Value << n->data.condition.str();
+            out << YAML::Key << "left" << YAML::Value << fp.node_ids_.at(n->left);
+            out << YAML::Key << "right" << YAML::Value << fp.node_ids_.at(n->right);
+            out << YAML::Key << "visits" << YAML::Value << fp.visits_[id];
+            out << YAML::Key << "p_right" << YAML::Value << fp.RightProbability(n);
+        }
+        out << YAML::EndMap;
+    }
+    out << YAML::EndSeq << YAML::EndMap;
+}
+
+} // namespace
+
+bool ProfileForests(const ForestHandler& fh, const pixel_set& ps, forests_profile& profile) {
+    if (ps.pixels_.empty() || ps.pixels_.front().size() != 2) {
+        cout << "Forests can only be profiled with 2D masks.\n";
+        return false;
+    }
+
+    replayer rp(fh, ps, profile);
+    if (rp.extra().size() > 4) {
+        cout << "Too many conditions are not pixels of the mask, forests cannot be profiled.\n";
+        return false;
+    }
+
+    for (const string& dataset : conf.datasets_) {
+        if (IsSyntheticVolumeDataset(dataset) || (IsSyntheticDataset(dataset) && !PrepareSyntheticDataset(dataset))) {
+            cout << "Forests cannot be profiled on dataset " << dataset << ", dataset skipped.\n";
+            continue;
+        }
+        path dataset_path = conf.global_input_path_ / path(dataset);
+        vector<pair<string, bool>> files_list;
+        if (!LoadFileList(files_list, (dataset_path / path("files.txt")).string())) {
+            cout << "Unable to find 'files.txt' of " << dataset_path << ", dataset skipped.\n";
+            continue;
+        }
+
+        binary_image img;
+        for (const auto& f : files_list) {
+            if (!GetBinaryImage((dataset_path / path(f.first)).string(), img, rp.border())) {
+                cout << "Unable to open " << f.first << ", image skipped.\n";
+                continue;
+            }
+            rp.Replay(img);
+            ++profile.images_;
+        }
+    }
+
+    return profile.images_ > 0;
+}
+
+bool SaveForestProfile(const path& p, const ForestHandler& fh, const forests_profile& profile) {
+    YAML::Emitter out;
+    out.SetDoublePrecision(6);
+    out << YAML::BeginMap;
+    out << YAML::Key << "images" << YAML::Value << profile.images_;
+    out << YAML::Key << "forests" << YAML::Value << YAML::BeginMap;
+    for (const auto& x : profile.lines_) {
+        const line_forest_profile& lp = x.second;
+        out << YAML::Key << fh.names.at(x.first) << YAML::Value << YAML::BeginMap;
+        out << YAML::Key << "lines" << YAML::Value << lp.lines_;
+        out << YAML::Key << "main" << YAML::Value;
+        SaveForest(out, lp.main_);
+        out << YAML::Key << "transitions" << YAML::Value << YAML::BeginSeq;
+        for (const auto& t : lp.transitions_) {
+            out << YAML::Flow << YAML::BeginSeq << t.first.first << t.first.second << t.second << YAML::EndSeq;
+        }
+        out << YAML::EndSeq;
+        out << YAML::Key << "end" << YAML::Value << YAML::BeginSeq;
+        for (const auto& e : lp.end_) {
+            SaveForest(out, e);
+        }
+        out << YAML::EndSeq;
+        out << YAML::EndMap;
+    }
+    out << YAML::EndMap << YAML::EndMap;
+
+    ofstream os(p);
+    if (!os) {
+        return false;
+    }
+    os << out.c_str() << "\n";
+    return bool(os);
+}
+
+bool ProfileForestsOnFile(const ForestHandler& fh, const pixel_set& ps) {
+    forests_profile profile;
+    if (!ProfileForests(fh, ps, profile)) {
+        cout << "Forests couldn't be profiled, no images available.\n";
+        return false;
+    }
+    const path p = conf.GetForestProfilePath();
+    if (!SaveForestProfile(p, fh, profile)) {
+        cerr << "Forests profile couldn't be stored into " << p << ".\n";
+        return false;
+    }
+    cout << "Forests profiled on " << profile.images_ << " images, profile stored into " << p << ".\n";
+    return true;
+}
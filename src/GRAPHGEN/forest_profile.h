@@ -0,0 +1,74 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_FOREST_PROFILE_H_
+#define GRAPHGEN_FOREST_PROFILE_H_
+
+#include <filesystem>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "forest_handler.h"
+#include "pixel_set.h"
+
+/** @file forest_profile.h
+
+Profiler of the forests generated with pixel prediction. The images of the
+datasets listed in the configuration file are replayed through the forests of
+a ForestHandler, exactly as the generated code would do: each line starts with
+the start tree, every leaf selects the next main tree through its "next" index,
+and the end of the line is handled by the end trees. The profile records how
+many times each tree is entered, the transitions between main trees, and how
+many times each node is visited and takes its right (condition true) branch.
+
+Conditions which are not pixels of the mask (e.g. the iteration of thinning
+algorithms) cannot be read from the images, so every image is replayed once for
+each of their combinations.
+
+ */
+
+// Statistics of a single forest, either the main forest or an end of the line forest
+struct forest_profile {
+    // Nodes of the forest in depth-first order from the roots, and their indexes
+    std::vector<const BinaryDrag<conact>::node*> nodes_;
+    std::unordered_map<const BinaryDrag<conact>::node*, size_t> node_ids_;
+
+    std::vector<unsigned long long> visits_;        // For each node, number of times it is reached
+    std::vector<unsigned long long> right_;         // For each non-leaf node, number of times its condition is true
+    std::vector<unsigned long long> tree_entries_;  // For each root, number of times the tree is executed
+
+    // Probability that the condition of n is true, given that n is reached. Nodes which are
+    // never reached have probability 0.5.
+    double RightProbability(const BinaryDrag<conact>::node* n) const;
+};
+
+struct line_forest_profile {
+    unsigned long long lines_ = 0;
+    forest_profile main_;
+    std::vector<forest_profile> end_;
+    // Number of times main tree "first" is followed by main tree "second" on the same line
+    std::map<std::pair<size_t, size_t>, unsigned long long> transitions_;
+};
+
+struct forests_profile {
+    unsigned long long images_ = 0;
+    std::map<ForestHandlerFlags, line_forest_profile> lines_;
+};
+
+// Replays the datasets of the configuration through the forests of fh. Returns false if
+// no image could be replayed.
+bool ProfileForests(const ForestHandler& fh, const pixel_set& ps, forests_profile& profile);
+
+// Stores profile in YAML format. Nodes are identified by their position in the depth-first
+// visit of their forest.
+bool SaveForestProfile(const std::filesystem::path& p, const ForestHandler& fh, const forests_profile& profile);
+
+// Profiles the forests of fh and stores the result alongside them (see ConfigData::GetForestProfilePath())
+bool ProfileForestsOnFile(const ForestHandler& fh, const pixel_set& ps);
+
+#endif // !GRAPHGEN_FOREST_PROFILE_H_
@@ -0,0 +1,237 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "frequency_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include "system_info.h"
+
+#if defined(GRAPHGEN_WINDOWS)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace filesystem;
+
+static const char kFrequencyMagic[8] = { 'G', 'R', 'G', 'N', 'F', 'R', 'E', 'Q' };
+static const uint32_t kFrequencyVersion = 1;
+
+static const uint64_t kFnvOffset = 14695981039346656037ull;
+static const uint64_t kFnvPrime = 1099511628211ull;
+
+uint64_t ConditionOrderHash(const rule_set& rs) {
+    uint64_t h = kFnvOffset;
+    for (const auto& c : rs.conditions) {
+        // The terminator keeps {"ab", "c"} and {"a", "bc"} apart
+        for (char ch : c + '\0') {
+            h = (h ^ static_cast<unsigned char>(ch)) * kFnvPrime;
+        }
+    }
+    return h;
+}
+
+// FNV-1a on 64 bits words
+uint64_t FrequencyChecksum(const unsigned long long* freqs, size_t n) {
+    uint64_t h = kFnvOffset;
+    for (size_t i = 0; i < n; ++i) {
+        h = (h ^ freqs[i]) * kFnvPrime;
+    }
+    return h;
+}
+
+static uint32_t ByteSwap32(uint32_t x) {
+    return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+static string FixedString(const char* s, size_t size) {
+    return string(s, find(s, s + size, '\0'));
+}
+
+void frequency_file::Close() {
+#if defined(GRAPHGEN_WINDOWS)
+    if (mapping_) UnmapViewOfFile(mapping_);
+    if (mapping_handle_) CloseHandle(mapping_handle_);
+    if (file_handle_ && file_handle_ != INVALID_HANDLE_VALUE) CloseHandle(file_handle_);
+    file_handle_ = mapping_handle_ = nullptr;
+#else
+    if (mapping_) munmap(mapping_, size_);
+#endif
+    mapping_ = nullptr;
+    size_ = 0;
+    freqs_ = nullptr;
+    rules_ = 0;
+    legacy_ = false;
+    info_ = frequency_file_info();
+}
+
+bool frequency_file::Open(const path& p, size_t rules, string& error) {
+    Close();
+
+#if defined(GRAPHGEN_WINDOWS)
+    file_handle_ = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle_ == INVALID_HANDLE_VALUE) {
+        error = "unable to open the file";
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle_, &file_size) || file_size.QuadPart == 0) {
+        error = "empty file";
+        return false;
+    }
+    size_ = static_cast<size_t>(file_size.QuadPart);
+    mapping_handle_ = CreateFileMappingW(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle_ == nullptr) {
+        error = "unable to map the file";
+        return false;
+    }
+    mapping_ = MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0);
+    if (mapping_ == nullptr) {
+        error = "unable to map the file";
+        return false;
+    }
+#else
+    int fd = open(p.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "unable to open the file";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        error = "empty file";
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* m = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        size_ = 0;
+        error = "unable to map the file";
+        return false;
+    }
+    mapping_ = m;
+#endif
+
+    const char* bytes = static_cast<const char*>(mapping_);
+    if (size_ < sizeof(frequency_file_header) || memcmp(bytes, kFrequencyMagic, sizeof(kFrequencyMagic)) != 0) {
+        if (size_ == rules * sizeof(unsigned long long)) {
+            legacy_ = true;
+            freqs_ = reinterpret_cast<const unsigned long long*>(bytes);
+            rules_ = rules;
+            return true;
+        }
+        error = "unknown format";
+        return false;
+    }
+
+    frequency_file_header h;
+    memcpy(&h, bytes, sizeof(h));
+    if (h.version == ByteSwap32(kFrequencyVersion)) {
+        error = "the file was written with a different byte order";
+        return false;
+    }
+    if (h.version != kFrequencyVersion) {
+        error = "unsupported version " + to_string(h.version);
+        return false;
+    }
+    if (h.header_size < sizeof(frequency_file_header) || h.header_size % 8 != 0 ||
+        h.rules > (size_ - min<size_t>(size_, h.header_size)) / sizeof(unsigned long long) ||
+        size_ != h.header_size + h.rules * sizeof(unsigned long long)) {
+        error = "corrupted header";
+        return false;
+    }
+
+    freqs_ = reinterpret_cast<const unsigned long long*>(bytes + h.header_size);
+    rules_ = static_cast<size_t>(h.rules);
+    if (FrequencyChecksum(freqs_, rules_) != h.checksum) {
+        error = "checksum mismatch";
+        return false;
+    }
+
+    info_.mask_name = FixedString(h.mask_name, sizeof(h.mask_name));
+    info_.dataset_name = FixedString(h.dataset_name, sizeof(h.dataset_name));
+    info_.condition_order_hash = h.condition_order_hash;
+    info_.images = h.images;
+    return true;
+}
+
+bool frequency_file::Matches(const frequency_file_info& expected, size_t rules, string& error) const {
+    if (rules_ != rules) {
+        error = "the file contains " + to_string(rules_) + " rules instead of " + to_string(rules);
+        return false;
+    }
+    if (legacy_) {
+        // Nothing else can be checked
+        return true;
+    }
+    if (info_.mask_name != expected.mask_name) {
+        error = "the file was generated with mask '" + info_.mask_name + "'";
+        return false;
+    }
+    if (info_.condition_order_hash != expected.condition_order_hash) {
+        error = "the file was generated with a different order of conditions";
+        return false;
+    }
+    if (info_.dataset_name != expected.dataset_name) {
+        error = "the file was generated on dataset '" + info_.dataset_name + "'";
+        return false;
+    }
+    return true;
+}
+
+bool SaveFrequencyFile(const path& p, const frequency_file_info& info, const vector<unsigned long long>& freqs) {
+    frequency_file_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, kFrequencyMagic, sizeof(kFrequencyMagic));
+    h.version = kFrequencyVersion;
+    h.header_size = sizeof(frequency_file_header);
+    h.rules = freqs.size();
+    h.condition_order_hash = info.condition_order_hash;
+    h.images = info.images;
+    h.checksum = FrequencyChecksum(freqs.data(), freqs.size());
+    if (info.mask_name.size() >= sizeof(h.mask_name) || info.dataset_name.size() >= sizeof(h.dataset_name)) {
+        return false;
+    }
+    memcpy(h.mask_name, info.mask_name.data(), info.mask_name.size());
+    memcpy(h.dataset_name, info.dataset_name.data(), info.dataset_name.size());
+
+    // Dataset names may contain folders, e.g. "random/classical"
+    error_code ec;
+    create_directories(p.parent_path(), ec);
+    ofstream os(p, ios::binary);
+    if (!os) {
+        return false;
+    }
+    os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    os.write(reinterpret_cast<const char*>(freqs.data()), freqs.size() * sizeof(unsigned long long));
+    return static_cast<bool>(os);
+}
+
+size_t AddFrequenciesSaturating(vector<unsigned long long>& dst, const unsigned long long* src, size_t n) {
+    size_t saturated = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (src[i] > numeric_limits<unsigned long long>::max() - dst[i]) {
+            dst[i] = numeric_limits<unsigned long long>::max();
+            ++saturated;
+        }
+        else {
+            dst[i] += src[i];
+        }
+    }
+    return saturated;
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_FREQUENCY_FILE_H_
+#define GRAPHGEN_FREQUENCY_FILE_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "rule_set.h"
+#include "system_info.h"
+
+/** @file frequency_file.h
+
+Frequency files store the number of occurrences of every rule of a rule set
+on a dataset. They start with a fixed size header describing where the
+frequencies come from, followed by an array of 64 bits unsigned integers,
+one for each rule. Files are memory-mapped when read, so frequencies are
+added to the rule set directly from the mapping: for this reason the header
+and the frequencies are stored in the byte order of the machine which wrote
+the file, and files with the other byte order are rejected.
+
+Files written by previous versions of GRAPHGEN are a bare array of
+frequencies. They are still accepted, with a warning, when their size
+matches the number of rules.
+
+ */
+
+struct frequency_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;           // Offset of the frequencies from the beginning of the file
+    uint64_t rules;                 // Number of frequencies stored in the file
+    uint64_t condition_order_hash;  // See ConditionOrderHash()
+    uint64_t images;                // Number of images counted
+    uint64_t checksum;              // See FrequencyChecksum()
+    char mask_name[64];
+    char dataset_name[192];
+};
+
+static_assert(sizeof(frequency_file_header) % 8 == 0, "frequencies must be aligned to 8 bytes");
+
+// Provenance of a set of frequencies
+struct frequency_file_info {
+    std::string mask_name;
+    std::string dataset_name;
+    uint64_t condition_order_hash = 0;
+    uint64_t images = 0;
+};
+
+// Hash of the names of the conditions of the rule set, in the order they appear in
+// the rule codes. Frequencies counted with a different order are meaningless.
+uint64_t ConditionOrderHash(const rule_set& rs);
+
+uint64_t FrequencyChecksum(const unsigned long long* freqs, size_t n);
+
+// Read-only memory mapping of a frequency file
+class frequency_file {
+    void* mapping_ = nullptr;
+    size_t size_ = 0;
+#ifdef GRAPHGEN_WINDOWS
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+    bool legacy_ = false;
+    frequency_file_info info_;
+    const unsigned long long* freqs_ = nullptr;
+    size_t rules_ = 0;
+
+    void Close();
+
+public:
+    frequency_file() {}
+    frequency_file(const frequency_file&) = delete;
+    frequency_file& operator=(const frequency_file&) = delete;
+    ~frequency_file() { Close(); }
+
+    // Maps the file and checks its header and checksum. rules is only used to recognize
+    // legacy files, which have no header.
+    bool Open(const std::filesystem::path& p, size_t rules, std::string& error);
+
+    // Checks that the file was generated with the expected mask, conditions order and dataset
+    bool Matches(const frequency_file_info& expected, size_t rules, std::string& error) const;
+
+    bool legacy() const { return legacy_; }
+    const frequency_file_info& info() const { return info_; }
+    const unsigned long long* data() const { return freqs_; }
+    size_t size() const { return rules_; }
+};
+
+bool SaveFrequencyFile(const std::filesystem::path& p, const frequency_file_info& info, const std::vector<unsigned long long>& freqs);
+
+// Adds n frequencies of src to dst, saturating instead of wrapping around. Returns the
+// number of frequencies that saturated.
+size_t AddFrequenciesSaturating(std::vector<unsigned long long>& dst, const unsigned long long* src, size_t n);
+
+#endif // !GRAPHGEN_FREQUENCY_FILE_H_
@@ -0,0 +1,181 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "frequency_kernels.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GRAPHGEN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GRAPHGEN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GRAPHGEN_TARGET_AVX2
+#endif
+
+using namespace std;
+
+static bool CpuSupportsAvx2() {
+#if defined(GRAPHGEN_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    // The OS must save the ymm registers (OSXSAVE and AVX bits, then XCR0)
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(GRAPHGEN_X86)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+bool IsPatternKernelSupported(PatternKernel kernel) {
+    switch (kernel) {
+    case PatternKernel::SCALAR: return true;
+    case PatternKernel::AVX2: {
+        static const bool supported = CpuSupportsAvx2();
+        return supported;
+    }
+    }
+    return false;
+}
+
+PatternKernel BestPatternKernel() {
+    if (IsPatternKernelSupported(PatternKernel::AVX2)) {
+        return PatternKernel::AVX2;
+    }
+    return PatternKernel::SCALAR;
+}
+
+string PatternKernelName(PatternKernel kernel) {
+    switch (kernel) {
+    case PatternKernel::SCALAR: return "scalar";
+    case PatternKernel::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+bool PatternKernelFromName(const string& name, PatternKernel& kernel) {
+    if (name == "auto") {
+        kernel = BestPatternKernel();
+    }
+    else if (name == "scalar") {
+        kernel = PatternKernel::SCALAR;
+    }
+    else if (name == "avx2") {
+        kernel = PatternKernel::AVX2;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// Computes the codes of positions [first, positions) of a row. rows[i] points to the
+// pixel read by the i-th mask pixel at position 0.
+static void PatternRowScalar(const uint8_t* const* rows, const int* bits, size_t n, size_t first, size_t positions, int increment, uint16_t* codes) {
+    fill(codes + first, codes + positions, uint16_t(0));
+    for (size_t i = 0; i < n; ++i) {
+        const uint8_t* row = rows[i];
+        const int bit = bits[i];
+        for (size_t k = first; k < positions; ++k) {
+            codes[k] |= static_cast<uint16_t>(row[k * increment] << bit);
+        }
+    }
+}
+
+#ifdef GRAPHGEN_X86
+// Computes 32 codes per step, as two vectors of 16 bits lanes. With increment 1 the
+// pixels are zero extended from bytes, with increment 2 even bytes are extracted by
+// reading 16 bits words and masking the high byte. Returns the number of codes computed.
+GRAPHGEN_TARGET_AVX2
+static size_t PatternRowAvx2(const uint8_t* const* rows, const int* bits, size_t n, size_t positions, int increment, uint16_t* codes) {
+    size_t k = 0;
+    if (increment == 1) {
+        for (; k + 32 <= positions; k += 32) {
+            __m256i lo = _mm256_setzero_si256();
+            __m256i hi = _mm256_setzero_si256();
+            for (size_t i = 0; i < n; ++i) {
+                const uint8_t* p = rows[i] + k;
+                const __m128i shift = _mm_cvtsi32_si128(bits[i]);
+                __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+                __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)));
+                lo = _mm256_or_si256(lo, _mm256_sll_epi16(a, shift));
+                hi = _mm256_or_si256(hi, _mm256_sll_epi16(b, shift));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + k), lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + k + 16), hi);
+        }
+    }
+    else if (increment == 2) {
+        const __m256i low_bytes = _mm256_set1_epi16(0x00FF);
+        // The last vector reads one byte past the last position, hence the strict comparison
+        for (; k + 32 < positions; k += 32) {
+            __m256i lo = _mm256_setzero_si256();
+            __m256i hi = _mm256_setzero_si256();
+            for (size_t i = 0; i < n; ++i) {
+                const uint8_t* p = rows[i] + 2 * k;
+                const __m128i shift = _mm_cvtsi32_si128(bits[i]);
+                __m256i a = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), low_bytes);
+                __m256i b = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)), low_bytes);
+                lo = _mm256_or_si256(lo, _mm256_sll_epi16(a, shift));
+                hi = _mm256_or_si256(hi, _mm256_sll_epi16(b, shift));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + k), lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + k + 16), hi);
+        }
+    }
+    return k;
+}
+#endif
+
+void CountPatterns(PatternKernel kernel, const uint8_t* data, size_t stride, int height, int width, int border, int increment,
+                   const vector<pattern_pixel>& pixels, unsigned long long* freqs) {
+    const int inner_width = width - 2 * border;
+    if (inner_width <= 0) {
+        return;
+    }
+    const size_t positions = (static_cast<size_t>(inner_width) + increment - 1) / increment;
+    const size_t n = pixels.size();
+
+    vector<uint16_t> codes(positions);
+    vector<const uint8_t*> rows(n);
+    vector<int> bits(n);
+    for (size_t i = 0; i < n; ++i) {
+        bits[i] = pixels[i].bit;
+    }
+
+    for (int r = border; r < height - border; r += increment) {
+        for (size_t i = 0; i < n; ++i) {
+            rows[i] = data + (r + pixels[i].dy) * stride + border + pixels[i].dx;
+        }
+
+        size_t done = 0;
+#ifdef GRAPHGEN_X86
+        if (kernel == PatternKernel::AVX2) {
+            done = PatternRowAvx2(rows.data(), bits.data(), n, positions, increment, codes.data());
+        }
+#endif
+        PatternRowScalar(rows.data(), bits.data(), n, done, positions, increment, codes.data());
+
+        for (size_t k = 0; k < positions; ++k) {
+            freqs[codes[k]]++;
+        }
+    }
+}
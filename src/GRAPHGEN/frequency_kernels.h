@@ -0,0 +1,57 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_FREQUENCY_KERNELS_H_
+#define GRAPHGEN_FREQUENCY_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** @file frequency_kernels.h
+
+Kernels computing the pattern code of every mask position of a binary image
+and accumulating them into an histogram. Codes are 16 bits wide, so kernels
+can only be used with masks of at most 16 conditions. The vectorized kernels
+are selected at runtime depending on the features of the CPU.
+
+ */
+
+// Position of a mask pixel with respect to the current position, and bit of the
+// pattern code it is stored into. Kernels only read dy and dx: volumes are counted
+// slice by slice, folding dz into dy (see CalculateConfigurationsFrequencyOnVolume()).
+struct pattern_pixel {
+    int dy, dx;
+    int bit;
+    int dz = 0;
+};
+
+enum class PatternKernel {
+    SCALAR,
+    AVX2,
+};
+
+constexpr size_t kMaxPatternKernelConditions = 16;
+
+bool IsPatternKernelSupported(PatternKernel kernel);
+
+// Fastest kernel supported by the current CPU
+PatternKernel BestPatternKernel();
+
+std::string PatternKernelName(PatternKernel kernel);
+
+// Returns false if name is not a valid kernel name. "auto" selects BestPatternKernel().
+bool PatternKernelFromName(const std::string& name, PatternKernel& kernel);
+
+// Counts the patterns of a binary image with one byte per pixel (0 or 1), surrounded
+// by a border of zeros at least as large as the mask. Positions are visited with the
+// given increment, starting from (border, border), and the occurrences of each code
+// are added to freqs.
+void CountPatterns(PatternKernel kernel, const uint8_t* data, size_t stride, int height, int width, int border, int increment,
+                   const std::vector<pattern_pixel>& pixels, unsigned long long* freqs);
+
+#endif // !GRAPHGEN_FREQUENCY_KERNELS_H_
@@ -0,0 +1,170 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "frequency_sampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "conact_tree.h"
+#include "hypercube.h"
+#include "image_frequencies.h"
+#include "splitmix64.h"
+
+using namespace std;
+
+vector<size_t> StratifiedSample(size_t n, double rate, mt19937_64& rng) {
+    vector<size_t> sample;
+    if (n == 0) {
+        return sample;
+    }
+    const size_t k = min(n, max<size_t>(1, static_cast<size_t>(llround(n * rate))));
+    sample.reserve(k);
+    for (size_t j = 0; j < k; ++j) {
+        size_t lo = j * n / k, hi = (j + 1) * n / k;
+        sample.push_back(uniform_int_distribution<size_t>(lo, hi - 1)(rng));
+    }
+    return sample;
+}
+
+frequency_sampler::frequency_sampler(size_t rules, double rows_rate, uint64_t seed, unsigned replicates) :
+    rows_rate_{ rows_rate }, seed_{ seed }, image_freqs_(rules), estimate_(rules), replicates_(replicates, vector<double>(rules)) {}
+
+vector<int> frequency_sampler::SampleLines(size_t positions, int increment, mt19937_64& rng) {
+    vector<int> lines;
+    for (size_t p : StratifiedSample(positions, rows_rate_, rng)) {
+        lines.push_back(static_cast<int>(p) * increment);
+    }
+    return lines;
+}
+
+void frequency_sampler::Accumulate(size_t positions, size_t sampled, mt19937_64& rng) {
+    rows_total_ += positions;
+    rows_sampled_ += sampled;
+
+    const double row_weight = static_cast<double>(positions) / sampled;
+    poisson_distribution<int> poisson(1.);
+    vector<int> weights(replicates_.size());
+    for (auto& w : weights) {
+        w = poisson(rng);
+    }
+
+    for (size_t i = 0; i < image_freqs_.size(); ++i) {
+        if (image_freqs_[i] == 0) {
+            continue;
+        }
+        const double v = image_freqs_[i] * row_weight;
+        estimate_[i] += v;
+        for (size_t b = 0; b < replicates_.size(); ++b) {
+            replicates_[b][i] += v * weights[b];
+        }
+    }
+}
+
+void frequency_sampler::Count(const binary_image& img, size_t index, const mask& msk) {
+    mt19937_64 rng(SplitMix64(seed_ ^ SplitMix64(index)));
+
+    const size_t positions = (img.rows_ + msk.increment_ - 1) / msk.increment_;
+    vector<int> rows = SampleLines(positions, msk.increment_, rng);
+    if (rows.empty()) {
+        return;
+    }
+
+    fill(image_freqs_.begin(), image_freqs_.end(), 0);
+    CalculateConfigurationsFrequencyOnImage(img, msk, image_freqs_, false, &rows);
+    Accumulate(positions, rows.size(), rng);
+}
+
+void frequency_sampler::Count(const binary_volume& vol, size_t index, const mask& msk) {
+    mt19937_64 rng(SplitMix64(seed_ ^ SplitMix64(index)));
+
+    const size_t positions = (vol.slices_ + msk.increment_z_ - 1) / msk.increment_z_;
+    vector<int> slices = SampleLines(positions, msk.increment_z_, rng);
+    if (slices.empty()) {
+        return;
+    }
+
+    fill(image_freqs_.begin(), image_freqs_.end(), 0);
+    CalculateConfigurationsFrequencyOnVolume(vol, msk, image_freqs_, false, &slices);
+    Accumulate(positions, slices.size(), rng);
+}
+
+void frequency_sampler::Finalize(double image_weight) {
+    for (auto& v : estimate_) {
+        v *= image_weight;
+    }
+    for (auto& r : replicates_) {
+        for (auto& v : r) {
+            v *= image_weight;
+        }
+    }
+}
+
+void ReportFrequencySampling(const rule_set& rs, const vector<vector<double>>& replicates, const string& report_path, bool check_odt) {
+    const size_t n_replicates = replicates.size();
+    if (n_replicates == 0) {
+        return;
+    }
+
+    auto write_error = [&report_path]() {
+        cerr << "Sampling report couldn't be stored into '" << report_path << "'.\n";
+    };
+    ofstream os(report_path);
+    if (!os) {
+        write_error();
+        return;
+    }
+    os << "# 95% percentile confidence intervals computed on " << n_replicates << " bootstrap replicates\n";
+    os << "# rule estimate low high\n";
+
+    size_t observed = 0, uncertain = 0;
+    vector<double> v(n_replicates);
+    const size_t lo_idx = static_cast<size_t>(floor(0.025 * (n_replicates - 1)));
+    const size_t hi_idx = static_cast<size_t>(ceil(0.975 * (n_replicates - 1)));
+    for (size_t i = 0; i < rs.rules.size(); ++i) {
+        for (size_t b = 0; b < n_replicates; ++b) {
+            v[b] = replicates[b][i];
+        }
+        sort(v.begin(), v.end());
+        const double estimate = static_cast<double>(rs.rules[i].frequency);
+        if (estimate == 0 && v[hi_idx] == 0) {
+            continue;
+        }
+        ++observed;
+        if ((v[hi_idx] - v[lo_idx]) / 2 > 0.1 * estimate) {
+            ++uncertain;
+        }
+        if (!(os << i << " " << rs.rules[i].frequency << " " << llround(v[lo_idx]) << " " << llround(v[hi_idx]) << "\n")) {
+            write_error();
+            return;
+        }
+    }
+    if (!os.flush()) {
+        write_error();
+        return;
+    }
+
+    cout << "Sampling: confidence intervals of " << observed << " observed rules written to '" << report_path << "', "
+         << uncertain << " of them have a half-width larger than 10% of the estimate.\n";
+
+    if (check_odt) {
+        BinaryDrag<conact> odt = GenerateOdt(rs);
+        rule_set replicate_rs = rs;
+        size_t changed = 0;
+        for (size_t b = 0; b < n_replicates; ++b) {
+            for (size_t i = 0; i < rs.rules.size(); ++i) {
+                replicate_rs.rules[i].frequency = static_cast<unsigned long long>(llround(replicates[b][i]));
+            }
+            BinaryDrag<conact> replicate_odt = GenerateOdt(replicate_rs);
+            if (!EqualTrees(odt.GetRoot(), replicate_odt.GetRoot())) {
+                ++changed;
+            }
+        }
+        cout << "Sampling: the ODT changes in " << changed << " of " << n_replicates << " bootstrap replicates.\n";
+    }
+}
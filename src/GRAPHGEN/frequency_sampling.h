@@ -0,0 +1,71 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_FREQUENCY_SAMPLING_H_
+#define GRAPHGEN_FREQUENCY_SAMPLING_H_
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "image_io.h"
+#include "rule_set.h"
+
+/** @file frequency_sampling.h
+
+Estimation of the frequencies from a sample of a dataset. Images are sampled
+with stratified sampling over the files list, and so are the mask rows of
+each sampled image (the slices, for volumes): the population is split into equally sized strata and a
+single element is drawn from each of them. Counts are weighted by the
+inverse of the sampling rates, so that estimates are comparable with full
+counts.
+
+The uncertainty of the estimates is measured with a Poisson bootstrap: every
+sampled image is added to each replicate with a Poisson(1) weight.
+
+ */
+
+struct mask;
+
+// Indices of the elements of a population of size n drawn by stratified sampling
+std::vector<size_t> StratifiedSample(size_t n, double rate, std::mt19937_64& rng);
+
+// Counts the sampled rows of the sampled images of a dataset
+class frequency_sampler {
+    double rows_rate_;
+    uint64_t seed_;
+    std::vector<unsigned long long> image_freqs_;
+
+    // Rows (or slices) to be counted, out of positions
+    std::vector<int> SampleLines(size_t positions, int increment, std::mt19937_64& rng);
+    // Adds the counts of sampled rows out of positions to the estimate and to the replicates
+    void Accumulate(size_t positions, size_t sampled, std::mt19937_64& rng);
+
+public:
+    // Row weighted counts of the sampled images, and their bootstrap replicates
+    std::vector<double> estimate_;
+    std::vector<std::vector<double>> replicates_;
+    // Mask rows, or slices for volumes
+    size_t rows_total_ = 0, rows_sampled_ = 0;
+
+    frequency_sampler(size_t rules, double rows_rate, uint64_t seed, unsigned replicates);
+
+    // index identifies the image, so that its rows and bootstrap weights do not depend
+    // on the order in which images are counted
+    void Count(const binary_image& img, size_t index, const mask& msk);
+    void Count(const binary_volume& vol, size_t index, const mask& msk);
+
+    // Scales estimates and replicates by the weight of the sampled images
+    void Finalize(double image_weight);
+};
+
+// Writes the per-rule confidence intervals computed from the bootstrap replicates and prints
+// a summary. If check_odt is set, the ODT is generated on every replicate and compared with the
+// one of the rule set.
+void ReportFrequencySampling(const rule_set& rs, const std::vector<std::vector<double>>& replicates, const std::string& report_path, bool check_odt);
+
+#endif // !GRAPHGEN_FREQUENCY_SAMPLING_H_
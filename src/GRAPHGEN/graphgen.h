@@ -2,12 +2,14 @@
 #define GRAPHGEN_GRAPHGEN_H_
 
 #include "base_ruleset.h"
+#include "compact_drag.h"
 #include "conact_code_generator.h"
 #include "conact_tree.h"
 #include "config_data.h"
 #include "connectivity_graph.h"
 #include "drag.h"
 #include "drag_compressor.h"
+#include "drag_journal.h"
 #include "drag_statistics.h"
 #include "drag2optimal.h"
 #include "find_optimal_drag.h"
@@ -19,10 +21,12 @@
 #include "hypercube++.h"
 #include "collect_drag_stats.h"
 #include "merge_set.h"
+#include "optimal_drag_solver.h"
 #include "output_generator.h"
 #include "tree2dag_identities.h"
 
 #ifdef GRAPHGEN_FREQUENCIES_ENABLED
+#include "forest_profile.h"
 #include "image_frequencies.h"
 #endif
 
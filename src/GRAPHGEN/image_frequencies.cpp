@@ -7,24 +7,38 @@
 #include "image_frequencies.h"
 
 #include <iostream>
+#include <fstream>
 #include <limits>
 #include <filesystem>
 #include <algorithm>
 #include <iterator>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cmath>
 
 #include "utilities.h"
 #include "performance_evaluator.h"
+#include "queue.h"
+#include "frequency_sampling.h"
+#include "synthetic_dataset.h"
 
 using namespace std;
 using namespace filesystem;
-using namespace cv;
 
 mask::mask(const rule_set& rs) : rs_{ rs } {
 	const auto& ps = rs.ps_;
     increment_ = ps.GetShiftX();
+    dims_ = static_cast<int>(ps.pixels_.front().size());
+    if (dims_ > 2) {
+        increment_z_ = ps.shifts_[2];
+    }
     exp_ = static_cast<int>(ps.pixels_.size());
     for (int i = 0; i < exp_; ++i) {
-        border_ = max(border_, max(abs(ps.pixels_[i].GetDx()), abs(ps.pixels_[i].GetDy())));
+        for (size_t d = 0; d < ps.pixels_[i].size(); ++d) {
+            border_ = max(border_, abs(ps.pixels_[i][d]));
+        }
         top_ = min(top_, ps.pixels_[i].GetDy());
         right_ = max(right_, ps.pixels_[i].GetDx());
         left_ = min(left_, ps.pixels_[i].GetDx());
@@ -34,22 +48,44 @@ mask::mask(const rule_set& rs) : rs_{ rs } {
     left_ = abs(left_);
     top_ = abs(top_);
 
-    mask_ = Mat1b(top_ + bottom_ + 1, left_ + right_ + 1, uchar(0));
+    mask_ = binary_image(top_ + bottom_ + 1, left_ + right_ + 1);
     for (int i = 0; i < exp_; ++i) {
         mask_(ps.pixels_[i].GetDy() + top_, ps.pixels_[i].GetDx() + left_) = 1;
+        pixels_.push_back({ ps.pixels_[i].GetDy(), ps.pixels_[i].GetDx(), static_cast<int>(rs.conditions_pos.at(ps.pixels_[i].name_)),
+                            dims_ > 2 ? ps.pixels_[i][2] : 0 });
+    }
+
+    use_kernel_ = rs.conditions.size() <= kMaxPatternKernelConditions;
+    if (!PatternKernelFromName(conf.frequencies_kernel_, kernel_)) {
+        cout << "WARNING: unknown frequencies kernel '" << conf.frequencies_kernel_ << "', 'auto' will be used.\n";
+        kernel_ = BestPatternKernel();
+    }
+    else if (!IsPatternKernelSupported(kernel_)) {
+        cout << "WARNING: frequencies kernel '" << conf.frequencies_kernel_ << "' is not supported by this CPU, 'scalar' will be used.\n";
+        kernel_ = PatternKernel::SCALAR;
     }
 }
 
-size_t mask::MaskToLinearMask(const cv::Mat1b& r_img) const {
+size_t mask::MaskToLinearMask(const binary_image& img, int r, int c) const {
     size_t linearMask = 0;
 
-	for (const auto& p : rs_.ps_) {
-		linearMask |= r_img(p.GetDy() + top_, p.GetDx() + left_) << rs_.conditions_pos.at(p.name_);
+	for (const auto& p : pixels_) {
+		linearMask |= static_cast<size_t>(img(r + p.dy, c + p.dx)) << p.bit;
 	}
 
     return linearMask;
 }
 
+size_t mask::MaskToLinearMask(const binary_volume& vol, int z, int r, int c) const {
+    size_t linearMask = 0;
+
+    for (const auto& p : pixels_) {
+        linearMask |= static_cast<size_t>(vol(z + p.dz, r + p.dy, c + p.dx)) << p.bit;
+    }
+
+    return linearMask;
+}
+
 // This function extracts all the configurations of a given mask (mask) in a given image (img) and stores the occurrences (frequencies) in the rRules vector
 //void CalculateConfigurationsFrequencyOnImage(const cv::Mat1b& img, const mask& msk, rule_set& rs) {
 //
@@ -71,19 +107,48 @@ size_t mask::MaskToLinearMask(const cv::Mat1b& r_img) const {
 //}
 
 
-// Overloaded function that accepts a vector instead of a ruleset
-void CalculateConfigurationsFrequencyOnImage(const cv::Mat1b& img, const mask& msk, vector<unsigned long long>& freqs) {
+// Overloaded function that accepts a vector instead of a ruleset. Unless reference is set, rule
+// sets small enough are counted with the pattern kernels, which are much faster than extracting
+// each configuration separately. If rows is not null, only the listed rows are counted.
+void CalculateConfigurationsFrequencyOnImage(const binary_image& img, const mask& msk, vector<unsigned long long>& freqs, bool reference, const vector<int>* rows) {
+
+    if (img.border_ < msk.border_) {
+        // The mask must be able to read outside of the image
+        binary_image padded(img.rows_, img.cols_, msk.border_);
+        for (int r = 0; r < img.rows_; ++r) {
+            copy(img.ptr(r), img.ptr(r) + img.cols_, padded.ptr(r));
+        }
+        CalculateConfigurationsFrequencyOnImage(padded, msk, freqs, reference, rows);
+        return;
+    }
 
-    cv::Mat1b clone;
-    copyMakeBorder(img, clone, msk.border_, msk.border_, msk.border_, msk.border_, cv::BORDER_CONSTANT, 0);
-    const int h = clone.rows, w = clone.cols;
+    if (msk.use_kernel_ && !reference) {
+        const int b = msk.border_;
+        if (rows == nullptr) {
+            CountPatterns(msk.kernel_, img.ptr(-b) - b, img.stride_, img.rows_ + 2 * b, img.cols_ + 2 * b, b, msk.increment_, msk.pixels_, freqs.data());
+        }
+        else {
+            // A view of 2 * border + 1 rows centered on r contains the single mask row r
+            for (int r : *rows) {
+                CountPatterns(msk.kernel_, img.ptr(r - b) - b, img.stride_, 2 * b + 1, img.cols_ + 2 * b, b, msk.increment_, msk.pixels_, freqs.data());
+            }
+        }
+        return;
+    }
 
-    for (int r = msk.border_; r < h - msk.border_; r += msk.increment_) {
+    vector<int> all_rows;
+    if (rows == nullptr) {
+        for (int r = 0; r < img.rows_; r += msk.increment_) {
+            all_rows.push_back(r);
+        }
+        rows = &all_rows;
+    }
+
+    for (int r : *rows) {
 
-        for (int c = msk.border_; c < w - msk.border_; c += msk.increment_) {
+        for (int c = 0; c < img.cols_; c += msk.increment_) {
 
-            const cv::Mat1b read_pixels = clone(cv::Rect(cv::Point(c - msk.left_, r - msk.top_), cv::Point(c + 1 + msk.right_, r + 1 + msk.bottom_)));
-            size_t rule = msk.MaskToLinearMask(read_pixels);
+            size_t rule = msk.MaskToLinearMask(img, r, c);
             freqs[rule]++;
             if (freqs[rule] == numeric_limits<unsigned long long>::max()) {
                 cout << "OVERFLOW freq\n";
@@ -92,22 +157,55 @@ void CalculateConfigurationsFrequencyOnImage(const cv::Mat1b& img, const mask& m
     }
 }
 
-bool GetBinaryImage(const string& FileName, cv::Mat1b& binary) {
-    // Image load
-    cv::Mat image;
-    image = cv::imread(FileName, cv::IMREAD_GRAYSCALE);   // Read the file
+// Volumes are counted like images, one slice at a time. Since slices are contiguous in
+// memory, a mask pixel dz slices away is equivalent to a pixel dz * (rows + 2 * border)
+// rows away, so the pattern kernels can be used with dz folded into dy. If slices is
+// not null, only the listed slices are counted.
+void CalculateConfigurationsFrequencyOnVolume(const binary_volume& vol, const mask& msk, vector<unsigned long long>& freqs, bool reference, const vector<int>* slices) {
+
+    if (vol.border_ < msk.border_) {
+        binary_volume padded(vol.slices_, vol.rows_, vol.cols_, msk.border_);
+        for (int z = 0; z < vol.slices_; ++z) {
+            for (int r = 0; r < vol.rows_; ++r) {
+                copy(vol.ptr(z, r), vol.ptr(z, r) + vol.cols_, padded.ptr(z, r));
+            }
+        }
+        CalculateConfigurationsFrequencyOnVolume(padded, msk, freqs, reference, slices);
+        return;
+    }
 
-    if (image.empty()) // Check if image exists
-        return false;
+    vector<int> all_slices;
+    if (slices == nullptr) {
+        for (int z = 0; z < vol.slices_; z += msk.increment_z_) {
+            all_slices.push_back(z);
+        }
+        slices = &all_slices;
+    }
 
-    //// Convert the image to grayscale
-    //Mat grayscaleMat;
-    //cvtColor(image, grayscaleMat, CV_RGB2GRAY);
+    if (msk.use_kernel_ && !reference) {
+        const int b = msk.border_;
+        vector<pattern_pixel> pixels = msk.pixels_;
+        for (auto& p : pixels) {
+            p.dy += p.dz * (vol.rows_ + 2 * vol.border_);
+        }
+        for (int z : *slices) {
+            CountPatterns(msk.kernel_, vol.ptr(z, -b) - b, vol.stride_, vol.rows_ + 2 * b, vol.cols_ + 2 * b, b, msk.increment_, pixels, freqs.data());
+        }
+        return;
+    }
 
-    // Adjust the threshold to actually make it binary
-    cv::threshold(image, binary, 100, 1, cv::THRESH_BINARY);
+    for (int z : *slices) {
+        for (int r = 0; r < vol.rows_; r += msk.increment_) {
+            for (int c = 0; c < vol.cols_; c += msk.increment_) {
 
-    return true;
+                size_t rule = msk.MaskToLinearMask(vol, z, r, c);
+                freqs[rule]++;
+                if (freqs[rule] == numeric_limits<unsigned long long>::max()) {
+                    cout << "OVERFLOW freq\n";
+                }
+            }
+        }
+    }
 }
 
 bool LoadFileList(vector<pair<string, bool>>& filenames, const string& files_path)
@@ -172,38 +270,262 @@ bool LoadFileList(vector<pair<string, bool>>& filenames, const string& files_pat
 //}
 
 
-bool CountFrequenciesOnDataset(const string& dataset, rule_set& rs, bool force) {
+// Items flowing through the frequency counting pipeline. An item whose index
+// is equal to numeric_limits<size_t>::max() tells a decoder to stop. Volumes
+// are made of several parts (see ReadVolumeFiles()), images of a single one.
+struct encoded_image {
+    size_t index = numeric_limits<size_t>::max();
+    vector<vector<uint8_t>> parts;
+    bool flat = false; // A 2D image found where a volume is expected
+};
+
+struct decoded_image {
+    size_t index = numeric_limits<size_t>::max();
+    binary_image img;
+    binary_volume vol;
+    bool flat = false;
+
+    bool empty() const { return img.empty() && vol.empty(); }
+    size_t total() const { return img.total() + vol.total(); }
+};
+
+// Busy time and amount of work performed by the threads of a pipeline stage
+struct stage_stats {
+    atomic<long long> busy_us{ 0 };
+    atomic<size_t> items{ 0 };
+    atomic<unsigned long long> units{ 0 };
+
+    template <typename F>
+    auto measure(F&& f) {
+        auto start = chrono::steady_clock::now();
+        auto ret = f();
+        busy_us += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        return ret;
+    }
 
-    path frequencies_output_path = conf.frequencies_path_ / conf.mask_name_ / (dataset + conf.frequencies_suffix_);
+    void print(const string& name, const string& item_name, const string& unit_name, double unit_scale, unsigned threads) const {
+        // Time spent by the average thread of the stage
+        double ms = busy_us / 1000. / threads;
+        double units_scaled = units / unit_scale;
+        cout << "  " << name << ": " << items << " " << item_name << ", " << units_scaled << " " << unit_name
+             << " in " << ms << " ms (" << (ms > 0 ? units_scaled * 1000. / ms : 0.) << " " << unit_name << "/s, "
+             << threads << (threads == 1 ? " thread)\n" : " threads)\n");
+    }
+};
+
+// Counts the frequencies of the images in files_list with a three stages pipeline: reader
+// threads load the raw bytes of the files, decoder threads turn them into binary images, and
+// the calling thread counts the configurations. With masks of three dimensions, files_list
+// contains volumes. Stages are connected by bounded queues, so
+// that readers and decoders cannot get too far ahead of the counter. Returns the number of
+// images counted. If sampler is not null, images are counted by the sampler instead of
+// being added to freqs.
+size_t CountFrequenciesOnFiles(const path& dataset_path, const vector<pair<string, bool>>& files_list, const mask& msk, vector<unsigned long long>& freqs, frequency_sampler* sampler = nullptr) {
+    const size_t n = files_list.size();
+    const unsigned read_threads = max(1u, conf.frequencies_read_threads_);
+    const unsigned decode_threads = conf.frequencies_decode_threads_ ? conf.frequencies_decode_threads_ : max(1u, thread::hardware_concurrency());
+
+    blocking_queue<encoded_image> encoded(conf.frequencies_queue_depth_);
+    blocking_queue<decoded_image> decoded(conf.frequencies_queue_depth_);
+    stage_stats read_stats, decode_stats, count_stats;
+    const bool volumes = msk.dims_ > 2;
+    const bool validate = conf.frequencies_validate_ && msk.use_kernel_ && sampler == nullptr;
+    vector<unsigned long long> reference_freqs(validate ? freqs.size() : 0, 0);
+    atomic<unsigned> running_readers{ read_threads };
+
+    PerformanceEvaluator perf;
+    perf.start();
+
+    vector<thread> readers;
+    for (unsigned t = 0; t < read_threads; ++t) {
+        readers.emplace_back([&, t]() {
+            for (size_t d = t; d < n; d += read_threads) {
+                encoded_image item;
+                item.index = d;
+                // A file that cannot be read still goes through the pipeline, so that the counter
+                // receives exactly one item per file and can report it
+                const string file_path = (dataset_path / path(files_list[d].first)).string();
+                read_stats.measure([&]() {
+                    if (volumes) {
+                        if (!ReadVolumeFiles(file_path, item.parts)) {
+                            return false;
+                        }
+                        // A single file which is not a raw volume is an image, that would be
+                        // counted as a volume with one slice
+                        error_code ec;
+                        item.flat = item.parts.size() == 1 && !is_directory(file_path, ec) && !IsRawVolume(item.parts[0]);
+                        return true;
+                    }
+                    item.parts.resize(1);
+                    return ReadImageFile(file_path, item.parts[0]);
+                });
+                read_stats.items++;
+                for (const auto& part : item.parts) {
+                    read_stats.units += part.size();
+                }
+                encoded.push(move(item));
+            }
+            if (--running_readers == 0) {
+                for (unsigned i = 0; i < decode_threads; ++i) {
+                    encoded.push(encoded_image());
+                }
+            }
+        });
+    }
 
-    if (!force) {
-        // Try to load frequencies from file
-        ifstream is;
-        is.exceptions(fstream::badbit | fstream::failbit | fstream::eofbit);
-
-        try {
-            is.open(frequencies_output_path, ios::binary);
-            vector<rule> new_rules = rs.rules;
-            std::for_each(new_rules.begin(), new_rules.end(), [&is](rule& r) { 
-				unsigned long long v;
-				is.read(reinterpret_cast<char*>(&v), 8);
-				r.frequency += v;
-			});
-            rs.rules = new_rules;
-            cout << "Frequencies of " << dataset << " were loaded from file.\n";
+    vector<thread> decoders;
+    for (unsigned t = 0; t < decode_threads; ++t) {
+        decoders.emplace_back([&]() {
+            while (true) {
+                encoded_image item = encoded.pop();
+                if (item.index == numeric_limits<size_t>::max()) {
+                    break;
+                }
+                decoded_image out;
+                out.index = item.index;
+                if (item.flat) {
+                    out.flat = true;
+                    decoded.push(move(out));
+                    continue;
+                }
+                // Images are decoded with the border required by the mask, so that they can be counted in place
+                if (decode_stats.measure([&]() { return volumes ? DecodeBinaryVolume(item.parts, out.vol, msk.border_) : DecodeBinaryImage(item.parts[0], out.img, msk.border_); })) {
+                    decode_stats.items++;
+                    decode_stats.units += out.total();
+                }
+                decoded.push(move(out));
+            }
+        });
+    }
+
+    for (size_t d = 0; d < n; ++d) {
+        cout << '\r' << d << '/' << n;
+        decoded_image item = decoded.pop();
+        if (item.flat) {
+            cout << "'" << files_list[item.index].first << "' in '" << dataset_path << "' dataset is a 2D image and cannot be counted with a 3D mask, image skipped\n";
+            continue;
+        }
+        if (item.empty()) {
+            cout << "Unable to find '" << files_list[item.index].first << "' " << (volumes ? "volume" : "image") << " in '" << dataset_path << "' dataset, "
+                 << (volumes ? "volume" : "image") << " skipped\n";
+            continue;
+        }
+        count_stats.measure([&]() {
+            if (sampler && volumes) {
+                sampler->Count(item.vol, item.index, msk);
+            }
+            else if (sampler) {
+                sampler->Count(item.img, item.index, msk);
+            }
+            else if (volumes) {
+                CalculateConfigurationsFrequencyOnVolume(item.vol, msk, freqs);
+            }
+            else {
+                CalculateConfigurationsFrequencyOnImage(item.img, msk, freqs);
+            }
             return true;
+        });
+        count_stats.items++;
+        count_stats.units += item.total();
+        if (validate && volumes) {
+            CalculateConfigurationsFrequencyOnVolume(item.vol, msk, reference_freqs, true);
+        }
+        else if (validate) {
+            CalculateConfigurationsFrequencyOnImage(item.img, msk, reference_freqs, true);
         }
-        catch (const ifstream::failure&) {
-            cout << "Frequencies of " << dataset << " couldn't be loaded from file.\n";
+    }
+    cout << '\r' << n << '/' << n << '\n';
+
+    if (validate) {
+        if (freqs == reference_freqs) {
+            cout << "Validation of the '" << PatternKernelName(msk.kernel_) << "' kernel against the reference counter succeeded.\n";
         }
-        catch (const runtime_error&) {
-            cout << "Frequencies of " << dataset << " couldn't be loaded from file.\n";
+        else {
+            cerr << "Validation of the '" << PatternKernelName(msk.kernel_) << "' kernel against the reference counter FAILED, reference frequencies will be used.\n";
+            freqs = reference_freqs;
         }
     }
 
+    for (auto& t : readers) {
+        t.join();
+    }
+    for (auto& t : decoders) {
+        t.join();
+    }
+
+    double elapsed = perf.stop();
+    cout << "Pipeline throughput (" << elapsed << " ms, queue depth " << conf.frequencies_queue_depth_
+         << ", " << (msk.use_kernel_ ? "'" + PatternKernelName(msk.kernel_) + "' kernel" : "reference counter") << "):\n";
+    const string items = volumes ? "volumes" : "images", units = volumes ? "Mvoxels" : "Mpixels";
+    read_stats.print("read", volumes ? "volumes" : "files", "MB", 1024. * 1024., read_threads);
+    decode_stats.print("decode", items, units, 1e6, decode_threads);
+    count_stats.print("count", items, units, 1e6, 1);
+
+    return count_stats.items;
+}
+
+// Adds the frequencies of dataset to rs. When sampling is enabled, the bootstrap replicates of
+// the frequencies are added to replicates.
+bool CountFrequenciesOnDataset(const string& dataset, rule_set& rs, bool force, vector<vector<double>>& replicates) {
+
+    const size_t dims = rs.ps_.pixels_.front().size();
+    if (dims > 3) {
+        cout << "Frequencies of masks with " << dims << " dimensions cannot be counted, dataset " << dataset << " skipped.\n";
+        return false;
+    }
+    if (IsSyntheticVolumeDataset(dataset) && dims < 3) {
+        cout << "Synthetic dataset " << dataset << " is made of volumes and cannot be counted with a 2D mask, dataset skipped.\n";
+        return false;
+    }
+
+    const bool sampling = conf.FrequenciesSampling();
+
+    frequency_file_info info;
+    info.mask_name = conf.mask_name_;
+    info.dataset_name = dataset;
+    info.condition_order_hash = ConditionOrderHash(rs);
+    if (IsSyntheticDataset(dataset)) {
+        // Synthetic datasets change with their parameters
+        info.dataset_name += " [" + SyntheticDatasetParameters(dataset) + "]";
+    }
+
+    // Sampled frequencies are stored in a different file, whose dataset name records the
+    // sampling parameters, so that a change of parameters triggers a new count
+    path frequencies_output_path = conf.frequencies_path_ / conf.mask_name_ / (dataset + conf.frequencies_suffix_);
+    if (sampling) {
+        frequencies_output_path = conf.frequencies_path_ / conf.mask_name_ / (dataset + "_sampled" + conf.frequencies_suffix_);
+        info.dataset_name += " [images " + to_string(conf.frequencies_sampling_images_) + ", rows " + to_string(conf.frequencies_sampling_rows_) +
+            ", seed " + to_string(conf.frequencies_sampling_seed_) + "]";
+    }
+
+    // Bootstrap replicates cannot be stored, so they require counting again. This is cheap,
+    // since replicates are only computed when sampling.
+    if (!force && replicates.empty()) {
+        // Try to load frequencies from file
+        frequency_file f;
+        string error;
+        if (f.Open(frequencies_output_path, rs.rules.size(), error) && f.Matches(info, rs.rules.size(), error)) {
+            const unsigned long long* freqs = f.data();
+            for (size_t i = 0; i < rs.rules.size(); ++i) {
+                rs.rules[i].frequency += freqs[i];
+            }
+            if (f.legacy()) {
+                cout << "WARNING: frequencies of " << dataset << " were loaded from a file without header, which cannot be checked against the current rule set.\n";
+            }
+            else {
+                cout << "Frequencies of " << dataset << " were loaded from file (" << f.info().images << " images).\n";
+            }
+            return true;
+        }
+        cout << "Frequencies of " << dataset << " couldn't be loaded from file: " << error << ".\n";
+    }
+
     mask msk(rs);
 
-    cv::Mat1b img;
+    if (IsSyntheticDataset(dataset) && !PrepareSyntheticDataset(dataset)) {
+        cout << "Unable to generate synthetic dataset " << dataset << ", dataset skipped.\n";
+        return false;
+    }
 
     path dataset_path = conf.global_input_path_ / path(dataset);
     vector<pair<string, bool>> files_list;
@@ -215,28 +537,43 @@ bool CountFrequenciesOnDataset(const string& dataset, rule_set& rs, bool force)
 
     vector<unsigned long long> freqs(rs.rules.size(), 0);
 
-    size_t files_list_size = files_list.size();
-    for (size_t d = 0; d < files_list_size; ++d) {
-        cout << '\r' << d << '/' << files_list_size;
-        path file_name = files_list[d].first;
-        GetBinaryImage((dataset_path / file_name).string(), img);
-        if (img.empty()) {
-            cout << "Unable to find '" << file_name << "' image in '" << dataset_path << "' dataset, image skipped\n";
-            continue;
+    if (sampling) {
+        // The seed is combined with the dataset name, so that datasets are sampled independently
+        uint64_t seed = conf.frequencies_sampling_seed_;
+        for (char c : dataset) {
+            seed = (seed ^ static_cast<unsigned char>(c)) * 1099511628211ull;
         }
-        CalculateConfigurationsFrequencyOnImage(img, msk, freqs);
+        mt19937_64 rng(seed);
+        vector<pair<string, bool>> sampled_files;
+        for (size_t i : StratifiedSample(files_list.size(), conf.frequencies_sampling_images_, rng)) {
+            sampled_files.push_back(files_list[i]);
+        }
+
+        frequency_sampler sampler(rs.rules.size(), conf.frequencies_sampling_rows_, seed, static_cast<unsigned>(replicates.size()));
+        info.images = CountFrequenciesOnFiles(dataset_path, sampled_files, msk, freqs, &sampler);
+        sampler.Finalize(info.images ? static_cast<double>(files_list.size()) / info.images : 0.);
+
+        cout << "Sampling: " << info.images << " of " << files_list.size() << (msk.dims_ > 2 ? " volumes, " : " images, ") << sampler.rows_sampled_ << " of "
+             << sampler.rows_total_ << (msk.dims_ > 2 ? " slices" : " mask rows") << " counted.\n";
+
+        for (size_t i = 0; i < freqs.size(); ++i) {
+            freqs[i] = static_cast<unsigned long long>(llround(sampler.estimate_[i]));
+        }
+        for (size_t b = 0; b < replicates.size(); ++b) {
+            for (size_t i = 0; i < freqs.size(); ++i) {
+                replicates[b][i] += sampler.replicates_[b][i];
+            }
+        }
+    }
+    else {
+        info.images = CountFrequenciesOnFiles(dataset_path, files_list, msk, freqs);
     }
-    cout << '\r' << files_list_size << '/' << files_list_size << '\n';
 
     for_each(freqs.begin(), freqs.end(), [rs_it = rs.rules.begin()](unsigned long long f) mutable { (*rs_it++).frequency += f; });
 
-    ofstream os(frequencies_output_path, ios::binary);
-    if (!os) {
+    if (!SaveFrequencyFile(frequencies_output_path, info, freqs)) {
         cerr << "Frequencies of " << dataset << " couldn't be stored into file.\n";
     }
-    else {
-        for_each(freqs.begin(), freqs.end(), [&os](unsigned long long f) { os.write(reinterpret_cast<const char*>(&f), 8); });
-    }
 
     return true;
 }
@@ -348,8 +685,19 @@ bool AddFrequenciesToRuleset(rule_set& rs, bool force, bool is_thinning) {
 
     int n = 0;
 
+    // Bootstrap replicates of the frequencies, only used when sampling
+    vector<vector<double>> replicates;
+    if (conf.FrequenciesSampling() && conf.frequencies_bootstrap_ > 0) {
+        if (rs.rules.size() * conf.frequencies_bootstrap_ > (1ull << 27)) {
+            cout << "WARNING: too many rules for " << conf.frequencies_bootstrap_ << " bootstrap replicates, confidence intervals will not be computed.\n";
+        }
+        else {
+            replicates.assign(conf.frequencies_bootstrap_, vector<double>(rs.rules.size()));
+        }
+    }
+
     for (const string& dataset : conf.datasets_) {
-        n += CountFrequenciesOnDataset(dataset, rs, force);
+        n += CountFrequenciesOnDataset(dataset, rs, force, replicates);
     }
 
 	if (is_thinning) {
@@ -358,8 +706,15 @@ bool AddFrequenciesToRuleset(rule_set& rs, bool force, bool is_thinning) {
 		for (size_t i = half; i < rs.rules.size(); i++) {
 			rs.rules[i].frequency = rs.rules[i - half].frequency;
 		}
+		for (auto& r : replicates) {
+			copy(r.begin(), r.begin() + half, r.begin() + half);
+		}
 	}
 
+    if (n > 0 && !replicates.empty()) {
+        ReportFrequencySampling(rs, replicates, (conf.algorithm_output_path_ / (conf.algorithm_name_ + "_sampling.txt")).string(), conf.frequencies_bootstrap_odt_);
+    }
+
     return n > 0;
 
 }
\ No newline at end of file
@@ -9,27 +9,37 @@
 
 #include <filesystem>
 
-#include <opencv2/core.hpp>
-#include <opencv2/imgcodecs.hpp>
-#include <opencv2/imgproc.hpp>
-
 #include "rule_set.h"
 #include "config_data.h"
+#include "frequency_file.h"
+#include "frequency_kernels.h"
+#include "image_io.h"
 
 struct mask {
-    cv::Mat1b mask_;
+    binary_image mask_;
     int top_ = 0, bottom_ = 0, left_ = 0, right_ = 0;
     int border_ = 0;
     int exp_;
     int increment_ = 0;
+    // Number of dimensions of the mask (2 for images, 3 for volumes), and shift along z
+    int dims_ = 2;
+    int increment_z_ = 1;
 	const rule_set& rs_;
+    std::vector<pattern_pixel> pixels_;
+    // Whether the rule set is small enough to be counted with the pattern kernels
+    bool use_kernel_ = false;
+    PatternKernel kernel_ = PatternKernel::SCALAR;
 
 	mask(const rule_set& rs);
-    size_t MaskToLinearMask(const cv::Mat1b& r_img) const;
+    // Pattern code of the mask placed on pixel (r, c) of img
+    size_t MaskToLinearMask(const binary_image& img, int r, int c) const;
+    // Pattern code of the mask placed on voxel (z, r, c) of vol
+    size_t MaskToLinearMask(const binary_volume& vol, int z, int r, int c) const;
 };
 
 //void CalculateConfigurationsFrequencyOnImage(const cv::Mat1b& img, const mask &msk, rule_set &rs);
-bool GetBinaryImage(const std::string &FileName, cv::Mat1b& binary);
+void CalculateConfigurationsFrequencyOnImage(const binary_image& img, const mask& msk, std::vector<unsigned long long>& freqs, bool reference = false, const std::vector<int>* rows = nullptr);
+void CalculateConfigurationsFrequencyOnVolume(const binary_volume& vol, const mask& msk, std::vector<unsigned long long>& freqs, bool reference = false, const std::vector<int>* slices = nullptr);
 bool LoadFileList(std::vector<std::pair<std::string, bool>>& filenames, const std::string& files_path);
 //bool CalculateRulesFrequencies(const pixel_set& ps, std::vector<std::pair<std::filesystem::path, bool>>& paths, rule_set& rs);
 //void CalculateRulesFrequencies(const pixel_set &ps, const std::vector<std::string> &paths, rule_set &rs);
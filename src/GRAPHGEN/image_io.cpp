@@ -0,0 +1,947 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "image_io.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#ifdef GRAPHGEN_FREQUENCIES_USE_OPENCV
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#endif
+
+using namespace std;
+
+// Every decoding error is reported with this exception, and turned into a false
+// return value by DecodeBinaryImage
+struct decode_error : runtime_error {
+    decode_error(const string& what) : runtime_error(what) {}
+};
+
+static inline uint8_t Binarize(unsigned gray) {
+    return gray > kBinaryThreshold ? 1 : 0;
+}
+
+// Same weights used by libpng (and thus by OpenCV) to convert RGB to gray
+static inline unsigned RgbToGray(unsigned r, unsigned g, unsigned b) {
+    return (r * 9798 + g * 19235 + b * 3735 + (1 << 14)) >> 15;
+}
+
+/*****************************************************************************/
+/* Inflate (RFC 1950/1951)                                                   */
+/*****************************************************************************/
+
+class inflater {
+    static constexpr int kMaxBits = 15;
+    static constexpr int kFastBits = 9;
+
+    struct huffman {
+        uint16_t count[kMaxBits + 1];
+        uint16_t symbol[288];
+        // Symbol and length of the codes up to kFastBits bits, indexed by the bit-reversed
+        // code. Entries equal to 0 require the slow (canonical) decoding.
+        uint16_t fast[1 << kFastBits];
+    };
+
+    const uint8_t* in_;
+    size_t in_size_;
+    size_t max_out_;
+    size_t pos_ = 0;
+    uint64_t bitbuf_ = 0;
+    int bitcnt_ = 0;
+    vector<uint8_t>& out_;
+
+    void Refill() {
+        while (bitcnt_ <= 56) {
+            // Past the end of the input zeros are read, which is detected by Bits()
+            uint64_t byte = pos_ < in_size_ ? in_[pos_] : 0;
+            ++pos_;
+            bitbuf_ |= byte << bitcnt_;
+            bitcnt_ += 8;
+        }
+    }
+
+    unsigned Bits(int n) {
+        if (bitcnt_ < n) {
+            Refill();
+        }
+        unsigned v = static_cast<unsigned>(bitbuf_ & ((1ull << n) - 1));
+        bitbuf_ >>= n;
+        bitcnt_ -= n;
+        // Bits consumed so far are pos_ * 8 - bitcnt_
+        if (pos_ * 8 > in_size_ * 8 + bitcnt_) {
+            throw decode_error("unexpected end of deflate stream");
+        }
+        return v;
+    }
+
+    static void Construct(huffman& h, const uint8_t* lengths, int n) {
+        memset(h.count, 0, sizeof(h.count));
+        memset(h.fast, 0, sizeof(h.fast));
+        for (int s = 0; s < n; ++s) {
+            h.count[lengths[s]]++;
+        }
+        h.count[0] = 0;
+
+        uint16_t offs[kMaxBits + 2];
+        int next_code[kMaxBits + 2];
+        offs[1] = 0;
+        next_code[1] = 0;
+        for (int len = 1; len <= kMaxBits; ++len) {
+            offs[len + 1] = offs[len] + h.count[len];
+            next_code[len + 1] = (next_code[len] + h.count[len]) << 1;
+        }
+        for (int s = 0; s < n; ++s) {
+            int len = lengths[s];
+            if (len == 0) {
+                continue;
+            }
+            h.symbol[offs[len]++] = static_cast<uint16_t>(s);
+            int code = next_code[len]++;
+            if (len <= kFastBits) {
+                int rev = 0;
+                for (int i = 0; i < len; ++i) {
+                    rev |= ((code >> i) & 1) << (len - 1 - i);
+                }
+                for (int i = rev; i < (1 << kFastBits); i += 1 << len) {
+                    h.fast[i] = static_cast<uint16_t>((s << 4) | len);
+                }
+            }
+        }
+    }
+
+    int Decode(const huffman& h) {
+        if (bitcnt_ < kMaxBits) {
+            Refill();
+        }
+        uint16_t entry = h.fast[bitbuf_ & ((1 << kFastBits) - 1)];
+        if (entry != 0) {
+            Bits(entry & 15);
+            return entry >> 4;
+        }
+        // Canonical decoding, one bit at a time
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len <= kMaxBits; ++len) {
+            code |= Bits(1);
+            int count = h.count[len];
+            if (code - count < first) {
+                return h.symbol[index + (code - first)];
+            }
+            index += count;
+            first += count;
+            first <<= 1;
+            code <<= 1;
+        }
+        throw decode_error("invalid huffman code");
+    }
+
+    void Stored() {
+        // Discard the remaining bits of the current byte
+        Bits(bitcnt_ % 8);
+        unsigned len = Bits(16);
+        unsigned nlen = Bits(16);
+        if (len != (~nlen & 0xFFFF)) {
+            throw decode_error("corrupted stored block");
+        }
+        if (out_.size() + len > max_out_) {
+            throw decode_error("deflate stream longer than expected");
+        }
+        for (unsigned i = 0; i < len; ++i) {
+            out_.push_back(static_cast<uint8_t>(Bits(8)));
+        }
+    }
+
+    void Codes(const huffman& lencode, const huffman& distcode) {
+        static const uint16_t len_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t len_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const uint16_t dist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const uint8_t dist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        while (true) {
+            int symbol = Decode(lencode);
+            if (out_.size() >= max_out_ && symbol != 256) {
+                throw decode_error("deflate stream longer than expected");
+            }
+            if (symbol < 256) {
+                out_.push_back(static_cast<uint8_t>(symbol));
+            }
+            else if (symbol == 256) {
+                return;
+            }
+            else {
+                symbol -= 257;
+                if (symbol >= 29) {
+                    throw decode_error("invalid length symbol");
+                }
+                size_t len = len_base[symbol] + Bits(len_extra[symbol]);
+                int dsym = Decode(distcode);
+                if (dsym >= 30) {
+                    throw decode_error("invalid distance symbol");
+                }
+                size_t dist = dist_base[dsym] + Bits(dist_extra[dsym]);
+                if (dist > out_.size()) {
+                    throw decode_error("distance too far back");
+                }
+                if (out_.size() + len > max_out_) {
+                    throw decode_error("deflate stream longer than expected");
+                }
+                size_t from = out_.size() - dist;
+                for (size_t i = 0; i < len; ++i) {
+                    out_.push_back(out_[from + i]);
+                }
+            }
+        }
+    }
+
+    void Fixed() {
+        static huffman lencode, distcode;
+        static const bool built = []() {
+            uint8_t lengths[288];
+            int s = 0;
+            for (; s < 144; ++s) lengths[s] = 8;
+            for (; s < 256; ++s) lengths[s] = 9;
+            for (; s < 280; ++s) lengths[s] = 7;
+            for (; s < 288; ++s) lengths[s] = 8;
+            Construct(lencode, lengths, 288);
+            for (s = 0; s < 30; ++s) lengths[s] = 5;
+            Construct(distcode, lengths, 30);
+            return true;
+        }();
+        (void)built;
+        Codes(lencode, distcode);
+    }
+
+    void Dynamic() {
+        static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        int nlen = Bits(5) + 257;
+        int ndist = Bits(5) + 1;
+        int ncode = Bits(4) + 4;
+        if (nlen > 286 || ndist > 30) {
+            throw decode_error("bad counts in dynamic block");
+        }
+
+        uint8_t lengths[320] = {};
+        for (int i = 0; i < ncode; ++i) {
+            lengths[order[i]] = static_cast<uint8_t>(Bits(3));
+        }
+        huffman lencode, distcode;
+        Construct(lencode, lengths, 19);
+
+        int index = 0;
+        while (index < nlen + ndist) {
+            int symbol = Decode(lencode);
+            if (symbol < 16) {
+                lengths[index++] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+            uint8_t len = 0;
+            int repeat;
+            if (symbol == 16) {
+                if (index == 0) {
+                    throw decode_error("repeat with no first length");
+                }
+                len = lengths[index - 1];
+                repeat = 3 + Bits(2);
+            }
+            else if (symbol == 17) {
+                repeat = 3 + Bits(3);
+            }
+            else {
+                repeat = 11 + Bits(7);
+            }
+            if (index + repeat > nlen + ndist) {
+                throw decode_error("too many lengths");
+            }
+            while (repeat--) {
+                lengths[index++] = len;
+            }
+        }
+
+        Construct(lencode, lengths, nlen);
+        Construct(distcode, lengths + nlen, ndist);
+        Codes(lencode, distcode);
+    }
+
+public:
+    // Decompressed data longer than max_out is treated as an error
+    inflater(const uint8_t* in, size_t in_size, size_t max_out, vector<uint8_t>& out) : in_{ in }, in_size_{ in_size }, max_out_{ max_out }, out_{ out } {}
+
+    // Decompresses a zlib stream, the checksum is not verified
+    void Zlib() {
+        if (in_size_ < 2 || (in_[0] & 0x0F) != 8 || ((in_[0] << 8) | in_[1]) % 31 != 0 || (in_[1] & 0x20)) {
+            throw decode_error("invalid zlib header");
+        }
+        pos_ = 2;
+        // Reserved once, so that copying the matches never reallocates. Deflate expands
+        // a byte into at most 1032 bytes (a match of 258 bytes takes at least 2 bits),
+        // hence the reservation is bounded by the size of the compressed data as well
+        out_.reserve(min(max_out_, in_size_ * 1032));
+        bool last;
+        do {
+            last = Bits(1);
+            switch (Bits(2)) {
+            case 0: Stored(); break;
+            case 1: Fixed(); break;
+            case 2: Dynamic(); break;
+            default: throw decode_error("invalid block type");
+            }
+        } while (!last);
+    }
+};
+
+/*****************************************************************************/
+/* PNG                                                                       */
+/*****************************************************************************/
+
+static uint32_t ReadBigEndian32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static void Unfilter(uint8_t* cur, const uint8_t* prev, size_t len, size_t bpp, uint8_t filter) {
+    switch (filter) {
+    case 0:
+        break;
+    case 1:
+        for (size_t i = bpp; i < len; ++i) cur[i] = static_cast<uint8_t>(cur[i] + cur[i - bpp]);
+        break;
+    case 2:
+        if (prev) {
+            for (size_t i = 0; i < len; ++i) cur[i] = static_cast<uint8_t>(cur[i] + prev[i]);
+        }
+        break;
+    case 3:
+        for (size_t i = 0; i < len; ++i) {
+            unsigned left = i >= bpp ? cur[i - bpp] : 0;
+            unsigned up = prev ? prev[i] : 0;
+            cur[i] = static_cast<uint8_t>(cur[i] + ((left + up) >> 1));
+        }
+        break;
+    case 4:
+        for (size_t i = 0; i < len; ++i) {
+            int a = i >= bpp ? cur[i - bpp] : 0;
+            int b = prev ? prev[i] : 0;
+            int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+            int p = a + b - c;
+            int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+            int pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            cur[i] = static_cast<uint8_t>(cur[i] + pred);
+        }
+        break;
+    default:
+        throw decode_error("invalid PNG filter");
+    }
+}
+
+static bool DecodePng(const vector<uint8_t>& bytes, binary_image& img, int border) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    if (bytes.size() < 8 || memcmp(bytes.data(), signature, 8) != 0) {
+        return false;
+    }
+
+    uint32_t width = 0, height = 0;
+    int depth = 0, color_type = -1, interlace = 0;
+    vector<uint8_t> palette;
+    vector<uint8_t> idat;
+
+    size_t pos = 8;
+    while (pos + 8 <= bytes.size()) {
+        uint32_t len = ReadBigEndian32(&bytes[pos]);
+        const uint8_t* type = &bytes[pos + 4];
+        const uint8_t* data = &bytes[pos + 8];
+        if (len > bytes.size() - pos - 8) {
+            throw decode_error("truncated PNG chunk");
+        }
+        if (memcmp(type, "IHDR", 4) == 0) {
+            if (len < 13) {
+                throw decode_error("invalid IHDR");
+            }
+            width = ReadBigEndian32(data);
+            height = ReadBigEndian32(data + 4);
+            depth = data[8];
+            color_type = data[9];
+            interlace = data[12];
+        }
+        else if (memcmp(type, "PLTE", 4) == 0) {
+            palette.assign(data, data + len);
+        }
+        else if (memcmp(type, "IDAT", 4) == 0) {
+            idat.insert(idat.end(), data, data + len);
+        }
+        else if (memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + static_cast<size_t>(len);
+    }
+
+    int channels;
+    switch (color_type) {
+    case 0: channels = 1; break;
+    case 2: channels = 3; break;
+    case 3: channels = 1; break;
+    case 4: channels = 2; break;
+    case 6: channels = 4; break;
+    default: throw decode_error("unsupported PNG color type");
+    }
+    if (width == 0 || height == 0 || width > (1u << 24) || height > (1u << 24) ||
+        (depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16) ||
+        (channels > 1 && depth < 8) || (color_type == 3 && depth == 16)) {
+        throw decode_error("unsupported PNG format");
+    }
+
+    const size_t bits_per_pixel = static_cast<size_t>(channels) * depth;
+    const size_t bpp = max<size_t>(1, bits_per_pixel / 8);
+    const unsigned max_sample = (1u << min(depth, 8)) - 1;
+
+    // Gray level of pixel x of an unfiltered scanline
+    auto gray = [&](const uint8_t* line, size_t x) -> unsigned {
+        if (depth < 8) {
+            size_t bit = x * depth;
+            unsigned v = (line[bit / 8] >> (8 - depth - bit % 8)) & max_sample;
+            if (color_type == 3) {
+                if (3 * v + 2 >= palette.size()) {
+                    return 0;
+                }
+                return RgbToGray(palette[3 * v], palette[3 * v + 1], palette[3 * v + 2]);
+            }
+            return v * 255 / max_sample;
+        }
+        // With 16 bits only the most significant byte is considered
+        const size_t step = depth / 8;
+        const uint8_t* p = line + x * channels * step;
+        switch (color_type) {
+        case 0:
+        case 4:
+            return p[0];
+        case 3:
+            if (3u * p[0] + 2 >= palette.size()) {
+                return 0;
+            }
+            return RgbToGray(palette[3 * p[0]], palette[3 * p[0] + 1], palette[3 * p[0] + 2]);
+        default:
+            return RgbToGray(p[0], p[step], p[2 * step]);
+        }
+    };
+
+    // Adam7 passes: starting row, starting column, row increment, column increment
+    static const int adam7[7][4] = { {0, 0, 8, 8}, {0, 4, 8, 8}, {4, 0, 8, 4}, {0, 2, 4, 4}, {2, 0, 4, 2}, {0, 1, 2, 2}, {1, 0, 2, 1} };
+    static const int single_pass[1][4] = { {0, 0, 1, 1} };
+    const int (*passes)[4] = interlace ? adam7 : single_pass;
+    const int npasses = interlace ? 7 : 1;
+
+    auto pass_size = [&](int p, size_t& pass_w, size_t& pass_h) {
+        pass_w = width > static_cast<uint32_t>(passes[p][1]) ? (width - passes[p][1] + passes[p][3] - 1) / passes[p][3] : 0;
+        pass_h = height > static_cast<uint32_t>(passes[p][0]) ? (height - passes[p][0] + passes[p][2] - 1) / passes[p][2] : 0;
+    };
+
+    // The image is allocated only once the data it requires has been decompressed, so
+    // that corrupted headers cannot cause huge allocations
+    size_t raw_size = 0;
+    for (int p = 0; p < npasses; ++p) {
+        size_t pass_w, pass_h;
+        pass_size(p, pass_w, pass_h);
+        if (pass_w != 0 && pass_h != 0) {
+            raw_size += pass_h * ((pass_w * bits_per_pixel + 7) / 8 + 1);
+        }
+    }
+    vector<uint8_t> raw;
+    inflater(idat.data(), idat.size(), raw_size, raw).Zlib();
+    if (raw.size() < raw_size) {
+        throw decode_error("truncated PNG image data");
+    }
+
+    img = binary_image(static_cast<int>(height), static_cast<int>(width), border);
+
+    size_t offset = 0;
+    for (int p = 0; p < npasses; ++p) {
+        size_t pass_w, pass_h;
+        pass_size(p, pass_w, pass_h);
+        if (pass_w == 0 || pass_h == 0) {
+            continue;
+        }
+        const size_t line_size = (pass_w * bits_per_pixel + 7) / 8;
+        const uint8_t* prev = nullptr;
+        for (size_t y = 0; y < pass_h; ++y) {
+            uint8_t filter = raw[offset];
+            uint8_t* line = &raw[offset + 1];
+            Unfilter(line, prev, line_size, bpp, filter);
+            uint8_t* out = img.ptr(static_cast<int>(passes[p][0] + y * passes[p][2]));
+            for (size_t x = 0; x < pass_w; ++x) {
+                out[passes[p][1] + x * passes[p][3]] = Binarize(gray(line, x));
+            }
+            prev = line;
+            offset += line_size + 1;
+        }
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+/* PBM / PGM                                                                 */
+/*****************************************************************************/
+
+class pnm_reader {
+    const vector<uint8_t>& bytes_;
+    size_t pos_;
+
+    void SkipSpacesAndComments() {
+        while (pos_ < bytes_.size()) {
+            if (bytes_[pos_] == '#') {
+                while (pos_ < bytes_.size() && bytes_[pos_] != '\n' && bytes_[pos_] != '\r') {
+                    ++pos_;
+                }
+            }
+            else if (isspace(bytes_[pos_])) {
+                ++pos_;
+            }
+            else {
+                break;
+            }
+        }
+    }
+
+public:
+    pnm_reader(const vector<uint8_t>& bytes, size_t pos) : bytes_{ bytes }, pos_{ pos } {}
+
+    unsigned Number() {
+        SkipSpacesAndComments();
+        if (pos_ >= bytes_.size() || !isdigit(bytes_[pos_])) {
+            throw decode_error("invalid PNM header");
+        }
+        unsigned long long v = 0;
+        while (pos_ < bytes_.size() && isdigit(bytes_[pos_])) {
+            v = v * 10 + (bytes_[pos_++] - '0');
+            if (v > (1u << 24)) {
+                throw decode_error("PNM value out of range");
+            }
+        }
+        return static_cast<unsigned>(v);
+    }
+
+    // P1 pixels do not need to be separated by spaces
+    unsigned Bit() {
+        SkipSpacesAndComments();
+        if (pos_ >= bytes_.size() || (bytes_[pos_] != '0' && bytes_[pos_] != '1')) {
+            throw decode_error("invalid PBM data");
+        }
+        return bytes_[pos_++] - '0';
+    }
+
+    size_t Remaining() const {
+        return pos_ < bytes_.size() ? bytes_.size() - pos_ : 0;
+    }
+
+    // Binary data starts after the single whitespace that follows the header
+    const uint8_t* Raster(size_t size) {
+        ++pos_;
+        if (pos_ > bytes_.size() || bytes_.size() - pos_ < size) {
+            throw decode_error("truncated PNM data");
+        }
+        return bytes_.data() + pos_;
+    }
+};
+
+static bool DecodePnm(const vector<uint8_t>& bytes, binary_image& img, int border) {
+    if (bytes.size() < 2 || bytes[0] != 'P' || (bytes[1] != '1' && bytes[1] != '2' && bytes[1] != '4' && bytes[1] != '5')) {
+        return false;
+    }
+    const char type = bytes[1];
+
+    pnm_reader reader(bytes, 2);
+    const unsigned width = reader.Number();
+    const unsigned height = reader.Number();
+    const unsigned maxval = (type == '2' || type == '5') ? reader.Number() : 1;
+    if (width == 0 || height == 0 || maxval == 0 || maxval > 65535) {
+        throw decode_error("unsupported PNM format");
+    }
+
+    // Plain formats need at least one character per pixel, while raw formats must contain
+    // the whole raster. This is checked before allocating the image.
+    const size_t pixels = static_cast<size_t>(width) * height;
+    const uint8_t* data = nullptr;
+    switch (type) {
+    case '1':
+    case '2':
+        if (reader.Remaining() < pixels) {
+            throw decode_error("truncated PNM data");
+        }
+        break;
+    case '4':
+        data = reader.Raster((width + 7) / 8 * static_cast<size_t>(height));
+        break;
+    case '5':
+        data = reader.Raster(pixels * (maxval < 256 ? 1 : 2));
+        break;
+    }
+
+    img = binary_image(static_cast<int>(height), static_cast<int>(width), border);
+
+    // In PBM images 1 is black
+    switch (type) {
+    case '1':
+        for (unsigned r = 0; r < height; ++r) {
+            uint8_t* out = img.ptr(r);
+            for (unsigned c = 0; c < width; ++c) {
+                out[c] = reader.Bit() ^ 1;
+            }
+        }
+        break;
+    case '4': {
+        const size_t line_size = (width + 7) / 8;
+        for (unsigned r = 0; r < height; ++r, data += line_size) {
+            uint8_t* out = img.ptr(r);
+            for (unsigned c = 0; c < width; ++c) {
+                out[c] = ((data[c / 8] >> (7 - c % 8)) & 1) ^ 1;
+            }
+        }
+        break;
+    }
+    case '2':
+        for (unsigned r = 0; r < height; ++r) {
+            uint8_t* out = img.ptr(r);
+            for (unsigned c = 0; c < width; ++c) {
+                out[c] = Binarize(min(reader.Number(), maxval) * 255 / maxval);
+            }
+        }
+        break;
+    case '5': {
+        const size_t sample_size = maxval < 256 ? 1 : 2;
+        if (maxval == 255) {
+            for (unsigned r = 0; r < height; ++r, data += width) {
+                uint8_t* out = img.ptr(r);
+                for (unsigned c = 0; c < width; ++c) {
+                    out[c] = Binarize(data[c]);
+                }
+            }
+        }
+        else {
+            for (unsigned r = 0; r < height; ++r) {
+                uint8_t* out = img.ptr(r);
+                for (unsigned c = 0; c < width; ++c, data += sample_size) {
+                    unsigned v = sample_size == 1 ? data[0] : (unsigned(data[0]) << 8) | data[1];
+                    out[c] = Binarize(min(v, maxval) * 255 / maxval);
+                }
+            }
+        }
+        break;
+    }
+    }
+
+    return true;
+}
+
+/*****************************************************************************/
+/* Raw volumes                                                               */
+/*****************************************************************************/
+
+bool IsRawVolume(const vector<uint8_t>& bytes) {
+    return bytes.size() >= 2 && bytes[0] == 'V' && (bytes[1] == '4' || bytes[1] == '5');
+}
+
+static bool DecodeRawVolume(const vector<uint8_t>& bytes, binary_volume& vol, int border) {
+    if (!IsRawVolume(bytes)) {
+        return false;
+    }
+    const char type = bytes[1];
+
+    pnm_reader reader(bytes, 2);
+    const unsigned width = reader.Number();
+    const unsigned height = reader.Number();
+    const unsigned depth = reader.Number();
+    const unsigned maxval = type == '5' ? reader.Number() : 1;
+    if (width == 0 || height == 0 || depth == 0 || maxval == 0 || maxval > 65535) {
+        throw decode_error("unsupported raw volume format");
+    }
+
+    const size_t line_size = type == '4' ? (width + 7) / 8 : static_cast<size_t>(width) * (maxval < 256 ? 1 : 2);
+    // The raster size would overflow with absurd dimensions
+    const size_t slice_size = line_size * height;
+    if (depth > bytes.size() / slice_size) {
+        throw decode_error("truncated raw volume data");
+    }
+    const uint8_t* data = reader.Raster(slice_size * depth);
+
+    vol = binary_volume(static_cast<int>(depth), static_cast<int>(height), static_cast<int>(width), border);
+    for (unsigned z = 0; z < depth; ++z) {
+        for (unsigned r = 0; r < height; ++r, data += line_size) {
+            uint8_t* out = vol.ptr(z, r);
+            if (type == '4') {
+                for (unsigned c = 0; c < width; ++c) {
+                    out[c] = (data[c / 8] >> (7 - c % 8)) & 1;
+                }
+            }
+            else if (maxval < 256) {
+                for (unsigned c = 0; c < width; ++c) {
+                    out[c] = Binarize(min<unsigned>(data[c], maxval) * 255 / maxval);
+                }
+            }
+            else {
+                for (unsigned c = 0; c < width; ++c) {
+                    unsigned v = (unsigned(data[2 * c]) << 8) | data[2 * c + 1];
+                    out[c] = Binarize(min(v, maxval) * 255 / maxval);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+#ifdef GRAPHGEN_FREQUENCIES_USE_OPENCV
+static bool DecodeOpenCV(const vector<uint8_t>& bytes, binary_image& img, int border) {
+    cv::Mat1b image;
+    try {
+        image = cv::imdecode(bytes, cv::IMREAD_GRAYSCALE);
+    }
+    catch (const cv::Exception&) {
+        return false;
+    }
+    if (image.empty()) {
+        return false;
+    }
+    img = binary_image(image.rows, image.cols, border);
+    for (int r = 0; r < image.rows; ++r) {
+        const uchar* in = image.ptr<uchar>(r);
+        uint8_t* out = img.ptr(r);
+        for (int c = 0; c < image.cols; ++c) {
+            out[c] = Binarize(in[c]);
+        }
+    }
+    return true;
+}
+#endif
+
+/*****************************************************************************/
+
+bool ReadImageFile(const string& FileName, vector<uint8_t>& bytes) {
+    // Folders can be opened as files on some systems
+    error_code ec;
+    if (!filesystem::is_regular_file(FileName, ec))
+        return false;
+
+    ifstream is(FileName, ios::binary | ios::ate);
+    if (!is) // Check if file exists
+        return false;
+
+    streamsize size = is.tellg();
+    if (size <= 0)
+        return false;
+
+    bytes.resize(static_cast<size_t>(size));
+    is.seekg(0);
+    return static_cast<bool>(is.read(reinterpret_cast<char*>(bytes.data()), size));
+}
+
+// Frames are read before being validated, so their size must be limited
+static const size_t kMaxFrameSize = static_cast<size_t>(min<unsigned long long>(1ull << 32, numeric_limits<size_t>::max() / 2));
+
+// Appends n bytes of the stream to bytes. On failure, bytes contains what was read.
+static bool ReadBytes(istream& is, vector<uint8_t>& bytes, size_t n) {
+    const size_t size = bytes.size();
+    bytes.resize(size + n);
+    is.read(reinterpret_cast<char*>(bytes.data() + size), n);
+    const size_t read = static_cast<size_t>(is.gcount());
+    bytes.resize(size + read);
+    return read == n;
+}
+
+// Reads a PNM-like header number, copying it, and the spaces and comments before it, into bytes
+static bool ReadHeaderNumber(istream& is, vector<uint8_t>& bytes, unsigned& v) {
+    int ch = is.get();
+    while (ch != EOF && (isspace(ch) || ch == '#')) {
+        bytes.push_back(static_cast<uint8_t>(ch));
+        if (ch == '#') {
+            while ((ch = is.get()) != EOF && ch != '\n' && ch != '\r') {
+                bytes.push_back(static_cast<uint8_t>(ch));
+            }
+            continue;
+        }
+        ch = is.get();
+    }
+    if (ch == EOF || !isdigit(ch)) {
+        return false;
+    }
+    unsigned long long value = 0;
+    while (ch != EOF && isdigit(ch)) {
+        bytes.push_back(static_cast<uint8_t>(ch));
+        value = value * 10 + (ch - '0');
+        if (value > (1u << 24)) {
+            return false;
+        }
+        ch = is.get();
+    }
+    // The single whitespace after the header is part of the image
+    if (ch != EOF) {
+        is.unget();
+    }
+    v = static_cast<unsigned>(value);
+    return true;
+}
+
+bool ReadImageFrame(istream& is, vector<uint8_t>& bytes, string& error) {
+    bytes.clear();
+    error.clear();
+
+    // Frames can be separated by whitespace
+    int ch;
+    while ((ch = is.peek()) != EOF && isspace(ch)) {
+        is.get();
+    }
+    if (!ReadBytes(is, bytes, 2)) {
+        if (is.gcount() > 0) {
+            error = "truncated frame";
+        }
+        return false;
+    }
+
+    if (bytes[0] == 0x89 && bytes[1] == 'P') {
+        // PNG: signature followed by chunks, the last of which is IEND
+        if (!ReadBytes(is, bytes, 6)) {
+            error = "truncated PNG frame";
+            return false;
+        }
+        while (true) {
+            const size_t chunk = bytes.size();
+            if (!ReadBytes(is, bytes, 8)) {
+                error = "truncated PNG frame";
+                return false;
+            }
+            const uint32_t length = ReadBigEndian32(bytes.data() + chunk);
+            if (length > kMaxFrameSize - bytes.size() || !ReadBytes(is, bytes, length + 4)) {
+                error = "truncated PNG frame";
+                return false;
+            }
+            if (memcmp(bytes.data() + chunk + 4, "IEND", 4) == 0) {
+                return true;
+            }
+        }
+    }
+
+    const bool pnm = bytes[0] == 'P' && (bytes[1] == '4' || bytes[1] == '5');
+    const bool volume = bytes[0] == 'V' && (bytes[1] == '4' || bytes[1] == '5');
+    if (!pnm && !volume) {
+        error = "unsupported frame format (only PNG, raw PBM and PGM, and raw volumes can be streamed)";
+        return false;
+    }
+    const bool bits = bytes[1] == '4';
+
+    unsigned width, height, depth = 1, maxval = 1;
+    if (!ReadHeaderNumber(is, bytes, width) || !ReadHeaderNumber(is, bytes, height) ||
+        (volume && !ReadHeaderNumber(is, bytes, depth)) || (!bits && !ReadHeaderNumber(is, bytes, maxval))) {
+        error = "invalid frame header";
+        return false;
+    }
+    if (width == 0 || height == 0 || depth == 0 || maxval == 0 || maxval > 65535) {
+        error = "unsupported frame header";
+        return false;
+    }
+
+    const size_t line_size = bits ? (width + 7) / 8 : static_cast<size_t>(width) * (maxval < 256 ? 1 : 2);
+    if (depth > kMaxFrameSize / (line_size * height)) {
+        error = "frame too large";
+        return false;
+    }
+    if (!ReadBytes(is, bytes, 1 + line_size * height * depth)) {
+        error = "truncated frame";
+        return false;
+    }
+    return true;
+}
+
+bool DecodeBinaryImage(const vector<uint8_t>& bytes, binary_image& img, int border) {
+    img = binary_image();
+    try {
+        if (DecodePng(bytes, img, border) || DecodePnm(bytes, img, border)) {
+            return true;
+        }
+    }
+    catch (const decode_error&) {
+        img = binary_image();
+        return false;
+    }
+#ifdef GRAPHGEN_FREQUENCIES_USE_OPENCV
+    return DecodeOpenCV(bytes, img, border);
+#else
+    return false;
+#endif
+}
+
+bool GetBinaryImage(const string& FileName, binary_image& img, int border) {
+    vector<uint8_t> bytes;
+    return ReadImageFile(FileName, bytes) && DecodeBinaryImage(bytes, img, border);
+}
+
+bool ReadVolumeFiles(const string& FileName, vector<vector<uint8_t>>& parts) {
+    parts.clear();
+    error_code ec;
+    if (!filesystem::is_directory(FileName, ec)) {
+        parts.emplace_back();
+        return ReadImageFile(FileName, parts.back());
+    }
+
+    vector<filesystem::path> slices;
+    for (const auto& entry : filesystem::directory_iterator(FileName, ec)) {
+        if (entry.is_regular_file(ec)) {
+            slices.push_back(entry.path());
+        }
+    }
+    sort(slices.begin(), slices.end());
+    parts.resize(slices.size());
+    for (size_t i = 0; i < slices.size(); ++i) {
+        if (!ReadImageFile(slices[i].string(), parts[i])) {
+            return false;
+        }
+    }
+    return !parts.empty();
+}
+
+bool DecodeBinaryVolume(const vector<vector<uint8_t>>& parts, binary_volume& vol, int border) {
+    vol = binary_volume();
+    if (parts.empty()) {
+        return false;
+    }
+    try {
+        if (parts.size() == 1 && DecodeRawVolume(parts[0], vol, border)) {
+            return true;
+        }
+    }
+    catch (const decode_error&) {
+        vol = binary_volume();
+        return false;
+    }
+
+    binary_image slice;
+    for (size_t z = 0; z < parts.size(); ++z) {
+        if (!DecodeBinaryImage(parts[z], slice)) {
+            vol = binary_volume();
+            return false;
+        }
+        if (z == 0) {
+            vol = binary_volume(static_cast<int>(parts.size()), slice.rows_, slice.cols_, border);
+        }
+        else if (slice.rows_ != vol.rows_ || slice.cols_ != vol.cols_) {
+            // All the slices must have the same size
+            vol = binary_volume();
+            return false;
+        }
+        for (int r = 0; r < slice.rows_; ++r) {
+            copy(slice.ptr(r), slice.ptr(r) + slice.cols_, vol.ptr(static_cast<int>(z), r));
+        }
+    }
+    return true;
+}
+
+bool GetBinaryVolume(const string& FileName, binary_volume& vol, int border) {
+    vector<vector<uint8_t>> parts;
+    return ReadVolumeFiles(FileName, parts) && DecodeBinaryVolume(parts, vol, border);
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_IMAGE_IO_H_
+#define GRAPHGEN_IMAGE_IO_H_
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+/** @file image_io.h
+
+Minimal image loader used by frequency calculation. It decodes PBM (P1, P4),
+PGM (P2, P5) and PNG images, converting them to grayscale and thresholding
+them while decoding, so that no external library is required. When GRAPHGEN
+is built with GRAPHGEN_FREQUENCIES_USE_OPENCV, any other format is decoded
+by OpenCV.
+
+Volumes are either folders of slices, sorted by file name, or raw volume
+files. Raw volumes have a PNM-like header, "V4 <width> <height> <depth>"
+followed by the voxels packed in bits (1 is foreground), or
+"V5 <width> <height> <depth> <maxval>" followed by one (or two, when maxval
+is larger than 255) bytes per voxel, thresholded like PGM images. Voxels are
+stored slice by slice, row by row, and rows of V4 volumes are padded to a
+whole byte.
+
+ */
+
+// Binary image with one byte per pixel (0 or 1), surrounded by a border of zeros,
+// so that masks can read the neighbors of any pixel without bound checks.
+struct binary_image {
+    int rows_ = 0, cols_ = 0;
+    int border_ = 0;
+    size_t stride_ = 0;
+    std::vector<uint8_t> data_;
+
+    binary_image() {}
+    binary_image(int rows, int cols, int border = 0) : rows_{ rows }, cols_{ cols }, border_{ border },
+        stride_{ static_cast<size_t>(cols) + 2 * border },
+        data_(stride_ * (static_cast<size_t>(rows) + 2 * border), 0) {}
+
+    bool empty() const { return rows_ == 0 || cols_ == 0; }
+    size_t total() const { return static_cast<size_t>(rows_) * cols_; }
+
+    // Row r of the image, with r in [-border_, rows_ + border_). Columns can be
+    // accessed in [-border_, cols_ + border_).
+    uint8_t* ptr(int r) { return data_.data() + (r + border_) * stride_ + border_; }
+    const uint8_t* ptr(int r) const { return data_.data() + (r + border_) * stride_ + border_; }
+
+    uint8_t& operator()(int r, int c) { return ptr(r)[c]; }
+    const uint8_t& operator()(int r, int c) const { return ptr(r)[c]; }
+};
+
+// Binary volume with one byte per voxel, surrounded by a border of zeros in every
+// direction. Slices are contiguous, so the voxels of the previous and next slices
+// are at a fixed distance (slice_stride_) from the current one.
+struct binary_volume {
+    int slices_ = 0, rows_ = 0, cols_ = 0;
+    int border_ = 0;
+    size_t stride_ = 0, slice_stride_ = 0;
+    std::vector<uint8_t> data_;
+
+    binary_volume() {}
+    binary_volume(int slices, int rows, int cols, int border = 0) : slices_{ slices }, rows_{ rows }, cols_{ cols }, border_{ border },
+        stride_{ static_cast<size_t>(cols) + 2 * border },
+        slice_stride_{ stride_ * (static_cast<size_t>(rows) + 2 * border) },
+        data_(slice_stride_ * (static_cast<size_t>(slices) + 2 * border), 0) {}
+
+    bool empty() const { return slices_ == 0 || rows_ == 0 || cols_ == 0; }
+    size_t total() const { return static_cast<size_t>(slices_) * rows_ * cols_; }
+
+    // Row r of slice z, with z in [-border_, slices_ + border_) and r in [-border_, rows_ + border_)
+    uint8_t* ptr(int z, int r) { return data_.data() + (z + border_) * slice_stride_ + (r + border_) * stride_ + border_; }
+    const uint8_t* ptr(int z, int r) const { return data_.data() + (z + border_) * slice_stride_ + (r + border_) * stride_ + border_; }
+
+    uint8_t& operator()(int z, int r, int c) { return ptr(z, r)[c]; }
+    const uint8_t& operator()(int z, int r, int c) const { return ptr(z, r)[c]; }
+};
+
+// Pixels with a gray level greater than this are set to 1
+constexpr int kBinaryThreshold = 100;
+
+bool ReadImageFile(const std::string& FileName, std::vector<uint8_t>& bytes);
+// Reads the next image from a stream of concatenated images (PNG, raw PBM and PGM, or
+// raw volumes). Returns false at the end of the stream, and also sets error if the
+// stream does not contain a valid image.
+bool ReadImageFrame(std::istream& is, std::vector<uint8_t>& bytes, std::string& error);
+bool DecodeBinaryImage(const std::vector<uint8_t>& bytes, binary_image& img, int border = 0);
+bool GetBinaryImage(const std::string& FileName, binary_image& img, int border = 0);
+
+// Checks whether bytes contain a raw volume, rather than an image
+bool IsRawVolume(const std::vector<uint8_t>& bytes);
+// Reads the slices of the volume stored in FileName, which is either a folder of slices
+// or a single file, containing a raw volume or an image (a volume with one slice, see
+// IsRawVolume() to tell them apart)
+bool ReadVolumeFiles(const std::string& FileName, std::vector<std::vector<uint8_t>>& parts);
+bool DecodeBinaryVolume(const std::vector<std::vector<uint8_t>>& parts, binary_volume& vol, int border = 0);
+bool GetBinaryVolume(const std::string& FileName, binary_volume& vol, int border = 0);
+
+#endif // !GRAPHGEN_IMAGE_IO_H_
@@ -0,0 +1,167 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_NODE_ARENA_H_
+#define GRAPHGEN_NODE_ARENA_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/** @brief Slab allocator which owns the nodes of a BinaryDrag.
+
+Nodes are constructed in place inside large slabs, whose size doubles every
+time a new slab is required, so that creating a node does not require a heap
+allocation and nodes created together are contiguous in memory. Nodes are never
+moved, hence their addresses are stable for the whole life of the arena, and
+they are only destroyed together with it: releasing a drag frees a handful of
+slabs instead of one block per node.
+
+Nodes are numbered in creation order: index_of() returns the number of a node,
+which can be used to store data about nodes in plain vectors instead of hash
+maps keyed by address.
+*/
+template<typename N>
+class node_arena {
+    struct slab {
+        N* data = nullptr;
+        size_t capacity = 0;
+        size_t used = 0;
+        size_t first = 0;   // Index of the first node of the slab
+    };
+
+    static constexpr size_t kFirstSlab = 64;
+    static constexpr size_t kMaxSlab = 1 << 16;
+
+    std::vector<slab> slabs_;
+    std::vector<size_t> by_address_;    // Indices of slabs_ sorted by the address of their data
+    size_t size_ = 0;
+
+    void AddSlab(size_t capacity) {
+        slab s;
+        s.data = std::allocator<N>().allocate(capacity);
+        s.capacity = capacity;
+        s.first = size_;
+        slabs_.push_back(s);
+        auto pos = std::upper_bound(by_address_.begin(), by_address_.end(), s.data, [this](const N* data, size_t i) {
+            return std::less<const N*>()(data, slabs_[i].data);
+        });
+        by_address_.insert(pos, slabs_.size() - 1);
+    }
+
+    void Release() {
+        for (auto& s : slabs_) {
+            if constexpr (!std::is_trivially_destructible_v<N>) {
+                std::destroy_n(s.data, s.used);
+            }
+            std::allocator<N>().deallocate(s.data, s.capacity);
+        }
+        slabs_.clear();
+        by_address_.clear();
+        size_ = 0;
+    }
+
+public:
+    node_arena() {}
+    node_arena(const node_arena&) = delete;
+    node_arena& operator=(const node_arena&) = delete;
+    node_arena(node_arena&& other) noexcept { swap(*this, other); }
+    node_arena& operator=(node_arena&& other) noexcept {
+        if (this != &other) {
+            Release();
+            swap(*this, other);
+        }
+        return *this;
+    }
+    ~node_arena() { Release(); }
+
+    friend void swap(node_arena& a, node_arena& b) noexcept {
+        using std::swap;
+        swap(a.slabs_, b.slabs_);
+        swap(a.by_address_, b.by_address_);
+        swap(a.size_, b.size_);
+    }
+
+    /** @brief Makes room for n more nodes in a single slab */
+    void reserve(size_t n) {
+        if (n == 0 || (!slabs_.empty() && slabs_.back().capacity - slabs_.back().used >= n)) {
+            return;
+        }
+        AddSlab(n);
+    }
+
+    /** @brief Constructs a new node and returns its address */
+    template<typename... Args>
+    N* make(Args&&... args) {
+        if (slabs_.empty() || slabs_.back().used == slabs_.back().capacity) {
+            AddSlab(slabs_.empty() ? kFirstSlab : std::min(kMaxSlab, std::max(kFirstSlab, size_)));
+        }
+        slab& s = slabs_.back();
+        N* n = ::new (static_cast<void*>(s.data + s.used)) N(std::forward<Args>(args)...);
+        ++s.used;
+        ++size_;
+        return n;
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    /** @brief Returns the creation index of n, which must belong to the arena */
+    size_t index_of(const N* n) const {
+        // The slab of n is the last one starting at or before n, found by binary search
+        auto pos = std::upper_bound(by_address_.begin(), by_address_.end(), n, [this](const N* node, size_t i) {
+            return std::less<const N*>()(node, slabs_[i].data);
+        });
+        if (pos != by_address_.begin()) {
+            const slab& s = slabs_[*std::prev(pos)];
+            if (std::less<const N*>()(n, s.data + s.used)) {
+                return s.first + static_cast<size_t>(n - s.data);
+            }
+        }
+        assert(false && "node does not belong to the arena");
+        return size_;
+    }
+
+    /** @brief Forward iterator over the addresses of the nodes, in creation order */
+    class iterator {
+        const std::vector<slab>* slabs_ = nullptr;
+        size_t slab_ = 0, pos_ = 0;
+
+        void Skip() {
+            while (slab_ < slabs_->size() && pos_ == (*slabs_)[slab_].used) {
+                ++slab_;
+                pos_ = 0;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = N*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = N**;
+        using reference = N*;
+
+        iterator() {}
+        iterator(const std::vector<slab>& slabs, size_t slab) : slabs_{ &slabs }, slab_{ slab } { Skip(); }
+
+        N* operator*() const { return (*slabs_)[slab_].data + pos_; }
+        iterator& operator++() { ++pos_; Skip(); return *this; }
+        iterator operator++(int) { iterator it = *this; ++*this; return it; }
+        bool operator==(const iterator& rhs) const { return slab_ == rhs.slab_ && pos_ == rhs.pos_; }
+        bool operator!=(const iterator& rhs) const { return !(*this == rhs); }
+    };
+
+    iterator begin() const { return iterator(slabs_, 0); }
+    iterator end() const { return iterator(slabs_, slabs_.size()); }
+};
+
+#endif // !GRAPHGEN_NODE_ARENA_H_
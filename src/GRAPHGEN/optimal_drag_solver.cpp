@@ -0,0 +1,469 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "optimal_drag_solver.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "remove_equal_subtrees.h"
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t kNone = numeric_limits<uint32_t>::max();
+constexpr size_t kInf = numeric_limits<size_t>::max();
+constexpr size_t kChunks = 256;     // Minimum number of chunks the search is split into
+
+// Key of the class of a node: its condition and the classes of its children
+struct node_key {
+    uint32_t condition, left, right;
+
+    bool operator==(const node_key& other) const {
+        return condition == other.condition && left == other.left && right == other.right;
+    }
+};
+
+struct node_key_hash {
+    size_t operator()(const node_key& k) const {
+        uint64_t h = (static_cast<uint64_t>(k.left) << 32 | k.right) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 31) ^ (k.condition * 0xC2B2AE3D27D4EB4Full));
+    }
+};
+
+// Objective: unique nodes first, then unique leaves
+struct cost {
+    size_t nodes = kInf, leaves = kInf;
+
+    bool operator<(const cost& other) const {
+        return nodes < other.nodes || (nodes == other.nodes && leaves < other.leaves);
+    }
+
+    // Single integer with the same order, so that it can be shared atomically
+    uint64_t Pack() const {
+        constexpr size_t kMax = numeric_limits<uint32_t>::max();
+        return static_cast<uint64_t>(min(nodes, kMax)) << 32 | min(leaves, kMax);
+    }
+};
+
+// State shared by the workers of a search
+struct search_state {
+    atomic<uint64_t> best{ cost{}.Pack() };  // Best cost found by any worker
+    atomic<uint64_t> explored{ 0 };
+    atomic<bool> aborted{ false };
+    uint64_t max_explored = 0;
+
+    void UpdateBest(const cost& c) {
+        uint64_t packed = c.Pack();
+        uint64_t cur = best.load();
+        while (packed < cur && !best.compare_exchange_weak(cur, packed)) {}
+    }
+};
+
+// Part of the search space: the options of the first variables are fixed
+struct search_chunk {
+    vector<uint32_t> prefix;
+    cost bound;
+
+    cost best;
+    vector<uint32_t> best_assignment;
+    size_t unexplored = kInf;
+};
+
+class solver {
+    using node = BinaryDrag<conact>::node;
+
+    // Reachable nodes in post-order, so that children precede their parents
+    vector<node*> nodes_;
+    vector<uint32_t> left_, right_;     // kNone for leaves
+    vector<uint32_t> group_;            // Shape of internal nodes (conditions and next trees)
+    vector<uint32_t> class_;            // Current class of fixed nodes, kNone for the others
+
+    // Leaves with multiple actions, in assignment order, with the classes of their options
+    vector<uint32_t> vars_;
+    vector<vector<uint>> var_actions_;
+    vector<vector<uint32_t>> var_classes_;
+    vector<vector<uint32_t>> fixed_by_; // Internal nodes fixed by the assignment of each variable, in post-order
+
+    // Classes of leaves and internal nodes share the same IDs
+    unordered_map<conact, uint32_t> leaf_classes_;
+    unordered_map<node_key, uint32_t, node_key_hash> node_classes_;
+    vector<uint32_t> class_count_;      // Fixed nodes in each class
+    vector<uint32_t> class_group_;      // kNone for classes of leaves
+    size_t nodes_distinct_ = 0, leaves_distinct_ = 0;
+
+    vector<uint32_t> group_classes_;    // Classes with at least a node, in each group
+    vector<uint32_t> group_free_;       // Nodes not fixed yet, in each group
+    size_t empty_groups_ = 0;           // Groups with nodes not fixed yet and no classes
+
+    vector<uint32_t> assignment_, best_assignment_;
+    cost best_;
+    search_state* state_ = nullptr;
+    uint64_t explored_ = 0;             // Not yet added to state_->explored
+    uint64_t batch_ = 1;                // Explored assignments are published in batches, to limit contention
+
+    uint32_t LeafClass(const conact& data) {
+        auto it = leaf_classes_.emplace(data, static_cast<uint32_t>(class_count_.size()));
+        if (it.second) {
+            class_count_.push_back(0);
+            class_group_.push_back(kNone);
+        }
+        return it.first->second;
+    }
+
+    uint32_t NodeClass(uint32_t i) {
+        node_key k{ nodes_[i]->data.condition.id(), class_[left_[i]], class_[right_[i]] };
+        auto it = node_classes_.emplace(k, static_cast<uint32_t>(class_count_.size()));
+        if (it.second) {
+            class_count_.push_back(0);
+            class_group_.push_back(group_[i]);
+        }
+        return it.first->second;
+    }
+
+    bool Empty(uint32_t g) const {
+        return group_classes_[g] == 0 && group_free_[g] > 0;
+    }
+
+    void AddToClass(uint32_t i, uint32_t c) {
+        class_[i] = c;
+        if (class_count_[c]++ > 0) {
+            return;
+        }
+        uint32_t g = class_group_[c];
+        if (g == kNone) {
+            ++leaves_distinct_;
+        }
+        else {
+            ++nodes_distinct_;
+            bool before = Empty(g);
+            ++group_classes_[g];
+            empty_groups_ += Empty(g) - before;
+        }
+    }
+
+    void RemoveFromClass(uint32_t i) {
+        uint32_t c = class_[i];
+        class_[i] = kNone;
+        if (--class_count_[c] > 0) {
+            return;
+        }
+        uint32_t g = class_group_[c];
+        if (g == kNone) {
+            --leaves_distinct_;
+        }
+        else {
+            --nodes_distinct_;
+            bool before = Empty(g);
+            --group_classes_[g];
+            empty_groups_ += Empty(g) - before;
+        }
+    }
+
+    void Fix(uint32_t i) {
+        uint32_t g = group_[i];
+        bool before = Empty(g);
+        --group_free_[g];
+        empty_groups_ += Empty(g) - before;
+        AddToClass(i, NodeClass(i));
+    }
+
+    void Unfix(uint32_t i) {
+        RemoveFromClass(i);
+        uint32_t g = group_[i];
+        bool before = Empty(g);
+        ++group_free_[g];
+        empty_groups_ += Empty(g) - before;
+    }
+
+    void Assign(size_t k, uint32_t option) {
+        AddToClass(vars_[k], var_classes_[k][option]);
+        for (uint32_t i : fixed_by_[k]) {
+            Fix(i);
+        }
+    }
+
+    void Unassign(size_t k) {
+        for (auto it = fixed_by_[k].rbegin(); it != fixed_by_[k].rend(); ++it) {
+            Unfix(*it);
+        }
+        RemoveFromClass(vars_[k]);
+    }
+
+    // Nodes with a different shape can never become equal, so every group without classes
+    // requires at least one more class
+    cost LowerBound() const {
+        return { nodes_distinct_ + empty_groups_, leaves_distinct_ };
+    }
+
+    // Options are pruned if they cannot improve the best drag of this chunk, or if they are worse
+    // than the best drag of any worker. Ties with other workers are not pruned, so that the drag
+    // found by each chunk, and hence the result, does not depend on the scheduling of the workers.
+    bool Prune(const cost& bound) const {
+        return !(bound < best_) || bound.Pack() > state_->best.load(memory_order_relaxed);
+    }
+
+    // Returns the lower bound of the part of the search space that was not explored
+    // because of the max_explored limit, kInf if it was entirely explored or pruned
+    size_t Search(size_t k) {
+        if (++explored_ == batch_) {
+            state_->explored += explored_;
+            explored_ = 0;
+        }
+        if (k == vars_.size()) {
+            cost c{ nodes_distinct_, leaves_distinct_ };
+            if (c < best_) {
+                best_ = c;
+                best_assignment_ = assignment_;
+                state_->UpdateBest(c);
+            }
+            return kInf;
+        }
+        // The limit is checked only once a complete assignment has been found
+        if (state_->max_explored > 0 && state_->explored.load(memory_order_relaxed) > state_->max_explored && state_->best.load(memory_order_relaxed) != cost{}.Pack()) {
+            state_->aborted = true;
+            return LowerBound().nodes;
+        }
+
+        // Options which lead to smaller drags are tried first
+        const size_t n_options = var_classes_[k].size();
+        vector<cost> bounds(n_options);
+        for (uint32_t o = 0; o < n_options; ++o) {
+            Assign(k, o);
+            bounds[o] = LowerBound();
+            Unassign(k);
+        }
+        vector<uint32_t> order(n_options);
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&bounds](uint32_t a, uint32_t b) { return bounds[a] < bounds[b]; });
+
+        size_t unexplored = kInf;
+        for (uint32_t o : order) {
+            if (state_->aborted.load(memory_order_relaxed)) {
+                unexplored = min(unexplored, bounds[o].nodes);
+                continue;
+            }
+            if (Prune(bounds[o])) {
+                continue;
+            }
+            Assign(k, o);
+            assignment_[k] = o;
+            unexplored = min(unexplored, Search(k + 1));
+            Unassign(k);
+        }
+        return unexplored;
+    }
+
+    uint32_t Collect(node* n, unordered_map<const node*, uint32_t>& ids, unordered_map<node_key, uint32_t, node_key_hash>& shapes, vector<int>& last_var) {
+        auto it = ids.find(n);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        uint32_t l = kNone, r = kNone, shape;
+        int last = -1;
+        if (n->isleaf()) {
+            // The shape of a leaf only depends on its next tree
+            shape = static_cast<uint32_t>(shapes.emplace(node_key{ kNone, kNone, static_cast<uint32_t>(n->data.next) }, static_cast<uint32_t>(shapes.size())).first->second);
+        }
+        else {
+            l = Collect(n->left, ids, shapes, last_var);
+            r = Collect(n->right, ids, shapes, last_var);
+            last = max(last_var[l], last_var[r]);
+            shape = shapes.emplace(node_key{ n->data.condition.id(), group_[l], group_[r] }, static_cast<uint32_t>(shapes.size())).first->second;
+        }
+        uint32_t i = static_cast<uint32_t>(nodes_.size());
+        nodes_.push_back(n);
+        left_.push_back(l);
+        right_.push_back(r);
+        group_.push_back(shape);
+        class_.push_back(kNone);
+        if (n->isleaf() && n->data.action.count() > 1) {
+            last = static_cast<int>(vars_.size());
+            vars_.push_back(i);
+        }
+        last_var.push_back(last);
+        ids[n] = i;
+        return i;
+    }
+
+public:
+    solver(BinaryDrag<conact>& t) {
+        unordered_map<const node*, uint32_t> ids;
+        unordered_map<node_key, uint32_t, node_key_hash> shapes;
+        vector<int> last_var;
+        for (node* r : t.roots_) {
+            Collect(r, ids, shapes, last_var);
+        }
+
+        // Shapes of leaves are not groups, but they share the numbering with the shapes of nodes
+        group_classes_.assign(shapes.size(), 0);
+        group_free_.assign(shapes.size(), 0);
+        fixed_by_.resize(vars_.size());
+        for (uint32_t k = 0; k < vars_.size(); ++k) {
+            conact data = nodes_[vars_[k]]->data;
+            var_actions_.push_back(data.actions());
+            var_classes_.emplace_back();
+            for (uint a : var_actions_.back()) {
+                data.action = 0;
+                data.action.set(a - 1);
+                var_classes_.back().push_back(LeafClass(data));
+            }
+        }
+
+        // Nodes which do not depend on any variable are fixed from the beginning
+        for (uint32_t i = 0; i < nodes_.size(); ++i) {
+            if (left_[i] == kNone) {
+                if (last_var[i] < 0) {
+                    AddToClass(i, LeafClass(nodes_[i]->data));
+                }
+            }
+            else {
+                uint32_t g = group_[i];
+                bool before = Empty(g);
+                ++group_free_[g];
+                empty_groups_ += Empty(g) - before;
+                if (last_var[i] < 0) {
+                    Fix(i);
+                }
+                else {
+                    fixed_by_[last_var[i]].push_back(i);
+                }
+            }
+        }
+        assignment_.assign(vars_.size(), 0);
+    }
+
+    // Splits the search space into chunks, fixing the options of the first variables, until
+    // there are at least min_chunks of them. Chunks are sorted by lower bound, so that the most
+    // promising ones are explored first.
+    vector<search_chunk> Split(size_t min_chunks) {
+        vector<search_chunk> chunks(1);
+        for (size_t k = 0; k < vars_.size() && chunks.size() < min_chunks; ++k) {
+            vector<search_chunk> next;
+            for (const auto& c : chunks) {
+                for (uint32_t o = 0; o < var_classes_[k].size(); ++o) {
+                    next.emplace_back();
+                    next.back().prefix = c.prefix;
+                    next.back().prefix.push_back(o);
+                }
+            }
+            chunks = move(next);
+        }
+        for (auto& c : chunks) {
+            AssignPrefix(c.prefix);
+            c.bound = LowerBound();
+            UnassignPrefix(c.prefix);
+        }
+        stable_sort(chunks.begin(), chunks.end(), [](const search_chunk& a, const search_chunk& b) { return a.bound < b.bound; });
+        return chunks;
+    }
+
+    void AssignPrefix(const vector<uint32_t>& prefix) {
+        for (size_t k = 0; k < prefix.size(); ++k) {
+            Assign(k, prefix[k]);
+            assignment_[k] = prefix[k];
+        }
+    }
+
+    void UnassignPrefix(const vector<uint32_t>& prefix) {
+        for (size_t k = prefix.size(); k-- > 0;) {
+            Unassign(k);
+        }
+    }
+
+    void Explore(search_chunk& c, search_state& state, uint64_t batch) {
+        state_ = &state;
+        batch_ = batch;
+        best_ = cost{};
+        AssignPrefix(c.prefix);
+        if (state.aborted) {
+            c.unexplored = LowerBound().nodes;
+        }
+        else if (!Prune(LowerBound())) {
+            c.unexplored = Search(c.prefix.size());
+        }
+        UnassignPrefix(c.prefix);
+        state.explored += explored_;
+        explored_ = 0;
+        c.best = best_;
+        c.best_assignment = move(best_assignment_);
+    }
+
+    optimal_drag_result Solve(uint64_t max_explored, unsigned threads) {
+        search_state state;
+        state.max_explored = max_explored;
+        size_t root_bound = LowerBound().nodes;
+
+        // The chunks do not depend on the number of threads, and neither does the result
+        vector<search_chunk> chunks = Split(kChunks);
+        if (threads == 1) {
+            for (auto& c : chunks) {
+                Explore(c, state, 1);
+            }
+        }
+        else {
+            // Each worker explores whole chunks on its own copy of the solver
+            atomic<size_t> next_chunk{ 0 };
+            vector<thread> workers;
+            for (unsigned i = 0; i < threads; ++i) {
+                workers.emplace_back([this, &chunks, &state, &next_chunk]() {
+                    solver s = *this;
+                    for (size_t c; (c = next_chunk++) < chunks.size();) {
+                        s.Explore(chunks[c], state, 1024);
+                    }
+                });
+            }
+            for (auto& w : workers) {
+                w.join();
+            }
+        }
+
+        // Ties are broken by chunk order, to make the result deterministic
+        optimal_drag_result res;
+        size_t unexplored = kInf;
+        cost best;
+        for (auto& c : chunks) {
+            unexplored = min(unexplored, c.unexplored);
+            if (c.best < best) {
+                best = c.best;
+                best_assignment_ = move(c.best_assignment);
+            }
+        }
+        res.nodes_ = best.nodes;
+        res.leaves_ = best.leaves;
+        res.optimal_ = !state.aborted;
+        res.lower_bound_ = res.optimal_ ? best.nodes : max(root_bound, min(unexplored, best.nodes));
+        res.explored_ = state.explored;
+        return res;
+    }
+
+    void Apply() {
+        for (size_t k = 0; k < vars_.size(); ++k) {
+            auto& action = nodes_[vars_[k]]->data.action;
+            action = 0;
+            action.set(var_actions_[k][best_assignment_[k]] - 1);
+        }
+    }
+};
+
+} // namespace
+
+optimal_drag_result SolveOptimalDrag(BinaryDrag<conact>& t, uint64_t max_explored, unsigned threads) {
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    solver s(t);
+    optimal_drag_result res = s.Solve(max_explored, threads);
+    s.Apply();
+    RemoveEqualSubtrees{ t };
+    return res;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_OPTIMAL_DRAG_SOLVER_H_
+#define GRAPHGEN_OPTIMAL_DRAG_SOLVER_H_
+
+#include <cstdint>
+
+#include "conact_tree.h"
+
+/** @brief Result of SolveOptimalDrag() */
+struct optimal_drag_result {
+    size_t nodes_ = 0;          // Unique nodes of the best drag found
+    size_t leaves_ = 0;         // Unique leaves of the best drag found
+    size_t lower_bound_ = 0;    // No assignment gives less than lower_bound_ nodes
+    bool optimal_ = false;      // Whether the search was completed, i.e., nodes_ and leaves_ are optimal
+    uint64_t explored_ = 0;     // Number of partial assignments explored
+
+    size_t Gap() const { return nodes_ - lower_bound_; }
+};
+
+/** @brief Chooses one action for each leaf of t with multiple actions, so that the drag obtained
+merging equal subtrees has the minimum number of unique nodes, and the minimum number of unique
+leaves among those.
+
+This is the problem solved by Dag2OptimalDag() and FindOptimalDrag enumerating all the
+combinations of actions. Here it is solved by branch and bound: leaves are assigned in post-order,
+so that subtrees become fixed as soon as possible, and the nodes of a fixed subtree are assigned to
+their equivalence class (hash-consing) incrementally, with undo on backtracking. Partial assignments
+are pruned with a lower bound on the final number of nodes: the classes of the fixed nodes, plus one
+for every group of nodes with the same shape (conditions and next trees, ignoring actions) that has
+no fixed node yet, since nodes with a different shape can never become equal.
+
+The search can be limited by max_explored: if the limit is reached (it is checked only after the
+first complete assignment has been found), the best drag found so far is returned, together with a
+certified lower bound on the optimum, so that the gap is known.
+
+The search space is split into chunks by fixing the actions of the first leaves, and each worker
+thread explores whole chunks on its own copy of the search state. Workers share only the cost of
+the best drag found so far, to prune each other's search. The best drag of each chunk does not
+depend on the other workers, so the result is the same with any number of threads (unless
+max_explored is reached).
+
+Leaves with multiple actions are identified by their node: shared leaves get the same action. t is
+modified in place: the chosen actions are set and equal subtrees are merged.
+
+@param[in,out] t The drag to optimize. All its roots are considered.
+@param[in] max_explored Maximum number of partial assignments to explore, 0 means no limit.
+@param[in] threads Number of worker threads, 0 means one per hardware thread.
+
+@return The statistics of the best drag found and the quality of the solution.
+*/
+optimal_drag_result SolveOptimalDrag(BinaryDrag<conact>& t, uint64_t max_explored = 0, unsigned threads = 1);
+
+#endif // !GRAPHGEN_OPTIMAL_DRAG_SOLVER_H_
@@ -1,7 +1,7 @@
 // Extrapolated from https://vorbrodt.blog/2019/02/09/template-concepts-sort-of/
 #pragma once
 
-#include "semaphore.h"
+#include "gg_semaphore.h"
 #include <mutex>
 #include <type_traits>
 #include <utility>
@@ -22,7 +22,7 @@ public:
   ~blocking_queue() noexcept {
     while (m_count--) {
       m_data[m_popIndex].~T();
-      m_popIndex = ++m_popIndex % m_size;
+      m_popIndex = (m_popIndex + 1) % m_size;
     }
     operator delete(m_data);
   }
@@ -36,7 +36,7 @@ public:
     {
       std::lock_guard<std::mutex> lock(m_cs);
       new (m_data + m_pushIndex) T(item);
-      m_pushIndex = ++m_pushIndex % m_size;
+      m_pushIndex = (m_pushIndex + 1) % m_size;
       ++m_count;
     }
     m_fullSlots.post();
@@ -56,7 +56,7 @@ public:
         m_openSlots.post();
         throw;
       }
-      m_pushIndex = ++m_pushIndex % m_size;
+      m_pushIndex = (m_pushIndex + 1) % m_size;
       ++m_count;
     }
     m_fullSlots.post();
@@ -71,7 +71,7 @@ public:
     {
       std::lock_guard<std::mutex> lock(m_cs);
       new (m_data + m_pushIndex) T(std::move(item));
-      m_pushIndex = ++m_pushIndex % m_size;
+      m_pushIndex = (m_pushIndex + 1) % m_size;
       ++m_count;
     }
     m_fullSlots.post();
@@ -91,7 +91,7 @@ public:
         m_openSlots.post();
         throw;
       }
-      m_pushIndex = ++m_pushIndex % m_size;
+      m_pushIndex = (m_pushIndex + 1) % m_size;
       ++m_count;
     }
     m_fullSlots.post();
@@ -107,7 +107,7 @@ public:
       std::lock_guard<std::mutex> lock(m_cs);
       item = m_data[m_popIndex];
       m_data[m_popIndex].~T();
-      m_popIndex = ++m_popIndex % m_size;
+      m_popIndex = (m_popIndex + 1) % m_size;
       --m_count;
     }
     m_openSlots.post();
@@ -128,7 +128,7 @@ public:
         throw;
       }
       m_data[m_popIndex].~T();
-      m_popIndex = ++m_popIndex % m_size;
+      m_popIndex = (m_popIndex + 1) % m_size;
       --m_count;
     }
     m_openSlots.post();
@@ -144,7 +144,7 @@ public:
       std::lock_guard<std::mutex> lock(m_cs);
       item = std::move(m_data[m_popIndex]);
       m_data[m_popIndex].~T();
-      m_popIndex = ++m_popIndex % m_size;
+      m_popIndex = (m_popIndex + 1) % m_size;
       --m_count;
     }
     m_openSlots.post();
@@ -165,7 +165,7 @@ public:
         throw;
       }
       m_data[m_popIndex].~T();
-      m_popIndex = ++m_popIndex % m_size;
+      m_popIndex = (m_popIndex + 1) % m_size;
       --m_count;
     }
     m_openSlots.post();
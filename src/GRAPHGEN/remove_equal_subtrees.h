@@ -7,72 +7,86 @@
 #ifndef GRAPHGEN_REMOVE_EQUAL_SUBTREES_H_
 #define GRAPHGEN_REMOVE_EQUAL_SUBTREES_H_
 
-#include <unordered_set>
+#include <unordered_map>
 
 #include "conact_tree.h"
+#include "drag_journal.h"
+#include "structural_hash.h"
 
 /** @brief This class allows to "remove" equal subtrees from a BinaryDrag.
 
 The class updates the input BinaryDrag itself so there is no need to build
 a non temporary object. Thus you can do: RemoveEqualSubtrees{bd}.
-The recursive procedure to find equal subtrees exploit memoization so it is
-quite efficient. Please note that the removal of equal subtrees is performed 
-updating the links but nodes are not actually deleted.
+Subtrees are identified by their 128-bit structural hash (see structural_hash.h),
+computed bottom-up with memoization, so the procedure takes linear time and
+memory. Since the children of a node are replaced by their representatives
+before the node itself is looked up, two nodes are equal if and only if they
+have the same data and the same children pointers: matching hashes are verified
+this way, in constant time. Please note that the removal of equal subtrees is
+performed updating the links but nodes are not actually deleted. When a
+DragJournal is provided, every node is saved into it before its links are updated.
 */
 struct RemoveEqualSubtrees {
-    std::unordered_map<std::string, BinaryDrag<conact>::node*> sp_; // string -> pointer
-    std::unordered_map<BinaryDrag<conact>::node*, std::string> ps_; // pointer -> string
+    std::unordered_multimap<hash128, BinaryDrag<conact>::node*> hp_; // hash -> representatives
+    std::unordered_map<const BinaryDrag<conact>::node*, hash128> ph_; // representative -> hash
     uint nodes_ = 0, leaves_ = 0;
+    DragJournal<conact>* journal_;
 
-    RemoveEqualSubtrees(BinaryDrag<conact>& bd) {
+    RemoveEqualSubtrees(BinaryDrag<conact>& bd, DragJournal<conact>* journal = nullptr) : journal_{ journal } {
+        ph_.reserve(bd.nodes_.size());
+        hp_.reserve(bd.nodes_.size());
         for (auto& t : bd.roots_) {
             RemoveEqualSubtreesRec(t);
         }
     }
 
-    std::string RemoveEqualSubtreesRec(BinaryDrag<conact>::node*& n)
+    // Only considers the drag reachable from root
+    RemoveEqualSubtrees(BinaryDrag<conact>::node*& root) : journal_{ nullptr } {
+        RemoveEqualSubtreesRec(root);
+    }
+
+    // parent is the node which n belongs to, nullptr for roots
+    hash128 RemoveEqualSubtreesRec(BinaryDrag<conact>::node*& n, BinaryDrag<conact>::node* parent = nullptr)
     {
         // Did we already find this node?
-        auto itps = ps_.find(n);
-        if (itps != end(ps_)) {
-            // Yes, return the string
-            return itps->second;
+        auto itph = ph_.find(n);
+        if (itph != end(ph_)) {
+            // Yes, return the hash
+            return itph->second;
         }
 
-        std::string s;
+        hash128 h;
         if (n->isleaf()) {
             ++leaves_;
-            //ss << setfill('0') << setw(3) << n->data.next;
-            //s = n->data.action.to_string() + ss.str();
-            const std::vector<uint>& a = n->data.actions();
-            s = '.' + std::to_string(a[0]);
-            for (std::size_t i = 1; i < a.size(); ++i) {
-                s += ',' + std::to_string(a[i]);
-            }
-            s += '-' + std::to_string(n->data.next);
+            h = LeafHash(n->data);
         }
         else {
             ++nodes_;
-            auto sl = RemoveEqualSubtreesRec(n->left);
-            auto sr = RemoveEqualSubtreesRec(n->right);
-            s = n->data.condition + sl + sr;
+            auto hl = RemoveEqualSubtreesRec(n->left, n);
+            auto hr = RemoveEqualSubtreesRec(n->right, n);
+            h = NodeHash(n->data.condition, hl, hr);
         }
 
-        auto it = sp_.find(s);
-        if (it == end(sp_)) {
-            sp_.insert({ s, n });
-            ps_.insert({ n, s });
-        }
-        else {
-            n = it->second;
-            if (n->isleaf()) {
-                --leaves_;
-            }
-            else {
-                --nodes_;
+        auto range = hp_.equal_range(h);
+        for (auto it = range.first; it != range.second; ++it) {
+            const BinaryDrag<conact>::node* r = it->second;
+            if (r->left == n->left && r->right == n->right && r->data == n->data) {
+                if (journal_ && parent) {
+                    journal_->Save(parent);
+                }
+                n = it->second;
+                if (n->isleaf()) {
+                    --leaves_;
+                }
+                else {
+                    --nodes_;
+                }
+                return h;
             }
         }
-        return s;
+        hp_.emplace(h, n);
+        ph_.emplace(n, h);
+        return h;
     }
 };
 
@@ -35,6 +35,7 @@
 #include <ostream>
 #include <unordered_map>
 
+#include "condition_action.h"
 #include "pixel_set.h"
 #include "utilities.h"
 
@@ -67,6 +68,8 @@ struct rule_set {
     }
 
     void AddCondition(const std::string& name) {
+        // Conditions are interned here, so that their IDs follow the order of the rule set
+        condition_name::Intern(name);
         conditions.emplace_back(name);
         conditions_pos[name] = conditions.size() - 1;
     }
@@ -0,0 +1,20 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_SPLITMIX64_H_
+#define GRAPHGEN_SPLITMIX64_H_
+
+#include <cstdint>
+
+// SplitMix64 mixer, which turns a seed and an index into the seed of an independent generator
+inline uint64_t SplitMix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+#endif // !GRAPHGEN_SPLITMIX64_H_
@@ -0,0 +1,82 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_STRUCTURAL_HASH_H_
+#define GRAPHGEN_STRUCTURAL_HASH_H_
+
+#include <cstdint>
+
+#include "condition_action.h"
+
+/** @file structural_hash.h
+
+128-bit structural hashes of (sub)trees, computed bottom-up: the hash of a leaf depends on
+its actions and next tree, the hash of a node on its condition ID and on the hashes of its
+children. Equal subtrees have equal hashes, so they can replace the string signatures used
+to find equal subtrees, taking constant memory per node. Different subtrees with the same
+hash are extremely unlikely but possible, hence users must verify matches exactly.
+*/
+
+struct hash128 {
+    uint64_t lo = 0, hi = 0;
+
+    bool operator==(const hash128& other) const { return lo == other.lo && hi == other.hi; }
+    bool operator!=(const hash128& other) const { return !(*this == other); }
+
+    // Adds a value to the hash. The two halves are updated by different functions, so that
+    // they behave as independent 64-bit hashes.
+    void Add(uint64_t v) {
+        lo = Mix(lo ^ (v + 0x9E3779B97F4A7C15ull));
+        hi = Mix((hi + v) * 0xC2B2AE3D27D4EB4Full + 0x165667B19E3779F9ull);
+    }
+
+    void Add(const hash128& h) {
+        Add(h.lo);
+        Add(h.hi);
+    }
+
+    // Finalizer of MurmurHash3
+    static uint64_t Mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ull;
+        x ^= x >> 33;
+        return x;
+    }
+};
+
+template<>
+struct std::hash<hash128> {
+    size_t operator()(const hash128& h) const {
+        return static_cast<size_t>(h.lo);
+    }
+};
+
+/** @brief Hash of a leaf, consistent with conact::operator== */
+inline hash128 LeafHash(const conact& data) {
+    using action_bits = decltype(conact::action);
+    static const action_bits word_mask(~0ull);
+    hash128 h;
+    h.Add(0x4C454146ull); // Leaves and nodes start differently
+    for (size_t i = 0; i < data.action.size(); i += 64) {
+        h.Add(((data.action >> i) & word_mask).to_ullong());
+    }
+    h.Add(static_cast<uint64_t>(data.next));
+    return h;
+}
+
+/** @brief Hash of a node, given the hashes of its children */
+inline hash128 NodeHash(const condition_name& condition, const hash128& left, const hash128& right) {
+    hash128 h;
+    h.Add(0x4E4F4445ull);
+    h.Add(condition.id());
+    h.Add(left);
+    h.Add(right);
+    return h;
+}
+
+#endif // !GRAPHGEN_STRUCTURAL_HASH_H_
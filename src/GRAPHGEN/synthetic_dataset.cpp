@@ -0,0 +1,492 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "synthetic_dataset.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "performance_evaluator.h"
+#include "splitmix64.h"
+#include "utilities.h"
+
+using namespace std;
+using namespace filesystem;
+
+// Bumped whenever generators change, so that existing datasets are generated again
+static const int kSyntheticVersion = 1;
+static const string kSyntheticPrefix = "synthetic/";
+static const string kSyntheticParamsFile = "params.txt";
+
+namespace {
+
+// Standard distributions are implementation defined, so only the raw output of
+// mt19937_64, which is fully specified, is used to keep images platform independent
+class synthetic_rng {
+    mt19937_64 gen_;
+
+public:
+    explicit synthetic_rng(uint64_t seed) : gen_(seed) {}
+
+    uint64_t Next() { return gen_(); }
+    // In [0, 1)
+    double Uniform() { return (gen_() >> 11) * (1. / 9007199254740992.); }
+    // In [lo, hi]
+    int Int(int lo, int hi) { return lo + static_cast<int>(gen_() % static_cast<uint64_t>(hi - lo + 1)); }
+    bool Bernoulli(double p) { return Uniform() < p; }
+};
+
+}
+
+// Every image has its own generator, so that it does not depend on the others
+static synthetic_rng ImageRng(const string& kind, size_t index) {
+    uint64_t h = 14695981039346656037ull;
+    for (char c : kind) {
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+    return synthetic_rng(SplitMix64(conf.synthetic_seed_ ^ SplitMix64(h + index)));
+}
+
+// Position of index in a sweep of n values going from lo to hi
+static double Sweep(size_t index, size_t n, double lo, double hi) {
+    return n > 1 ? lo + (hi - lo) * index / (n - 1) : (lo + hi) / 2;
+}
+
+// Sets the pixels of a row with probability density. Each 64 bits random number gives 4 pixels.
+static void NoiseRow(uint8_t* row, int cols, double density, synthetic_rng& rng) {
+    const uint64_t threshold = static_cast<uint64_t>(llround(density * 65536.));
+    for (int c = 0; c < cols; c += 4) {
+        uint64_t r = rng.Next();
+        for (int k = 0; k < 4 && c + k < cols; ++k, r >>= 16) {
+            row[c + k] = (r & 0xFFFF) < threshold;
+        }
+    }
+}
+
+// Random noise with density increasing along the dataset
+static void GenerateRandom(binary_image& img, size_t index, size_t n, synthetic_rng& rng) {
+    const double density = Sweep(index, n, 0., 1.);
+    for (int r = 0; r < img.rows_; ++r) {
+        NoiseRow(img.ptr(r), img.cols_, density, rng);
+    }
+}
+
+static const int kGranularities[] = { 1, 2, 4, 8, 16 };
+static const size_t kGranularitiesCount = sizeof(kGranularities) / sizeof(kGranularities[0]);
+
+// Noise made of g x g blocks: images cycle over the granularities, and densities
+// increase every time the cycle restarts
+static void GranularityParameters(size_t index, size_t n, int& g, double& density) {
+    g = kGranularities[index % kGranularitiesCount];
+    density = Sweep(index / kGranularitiesCount, (n + kGranularitiesCount - 1) / kGranularitiesCount, .1, .9);
+}
+
+static void GenerateGranularity(binary_image& img, size_t index, size_t n, synthetic_rng& rng) {
+    int g;
+    double density;
+    GranularityParameters(index, n, g, density);
+    vector<uint8_t> blocks((img.cols_ + g - 1) / g);
+    for (int r = 0; r < img.rows_; ++r) {
+        if (r % g == 0) {
+            NoiseRow(blocks.data(), static_cast<int>(blocks.size()), density, rng);
+        }
+        uint8_t* row = img.ptr(r);
+        for (int c = 0; c < img.cols_; ++c) {
+            row[c] = blocks[c / g];
+        }
+    }
+}
+
+static void FillRect(binary_image& img, int x, int y, int w, int h) {
+    const int x0 = max(0, x), x1 = min(img.cols_, x + w);
+    const int y0 = max(0, y), y1 = min(img.rows_, y + h);
+    for (int r = y0; r < y1; ++r) {
+        fill(img.ptr(r) + x0, img.ptr(r) + max(x0, x1), 1);
+    }
+}
+
+// Line with square pen of size t
+static void DrawLine(binary_image& img, int x0, int y0, int x1, int y1, int t) {
+    const int steps = max(abs(x1 - x0), abs(y1 - y0));
+    for (int s = 0; s <= steps; ++s) {
+        const int x = steps ? x0 + (x1 - x0) * s / steps : x0;
+        const int y = steps ? y0 + (y1 - y0) * s / steps : y0;
+        FillRect(img, x - t / 2, y - t / 2, t, t);
+    }
+}
+
+// Outline of the ellipse inscribed in the given box, with thickness t
+static void DrawEllipse(binary_image& img, int x, int y, int w, int h, int t) {
+    const double a = w / 2., b = h / 2., cx = x + a, cy = y + b;
+    if (a <= t || b <= t) {
+        FillRect(img, x, y, w, h);
+        return;
+    }
+    for (int r = max(0, y); r < min(img.rows_, y + h); ++r) {
+        for (int c = max(0, x); c < min(img.cols_, x + w); ++c) {
+            const double dx = c + .5 - cx, dy = r + .5 - cy;
+            const double outer = dx * dx / (a * a) + dy * dy / (b * b);
+            const double inner = dx * dx / ((a - t) * (a - t)) + dy * dy / ((b - t) * (b - t));
+            if (outer <= 1. && inner >= 1.) {
+                img(r, c) = 1;
+            }
+        }
+    }
+}
+
+// Glyph made of a few strokes. size is the height of the line, from the top of the
+// ascenders to the bottom of the descenders.
+static void DrawGlyph(binary_image& img, int x, int y, int w, int size, int t, synthetic_rng& rng) {
+    const int baseline = y + size * 3 / 4;
+    const int x_height = size / 2;
+    const int top = rng.Bernoulli(.3) ? y : baseline - x_height;
+    const int bottom = rng.Bernoulli(.15) ? y + size : baseline;
+    const int middle = baseline - x_height / 2;
+
+    const int strokes = rng.Int(2, 3);
+    for (int s = 0; s < strokes; ++s) {
+        switch (rng.Int(0, 7)) {
+        case 0: FillRect(img, x, top, t, bottom - top); break;
+        case 1: FillRect(img, x + w - t, top, t, bottom - top); break;
+        case 2: FillRect(img, x, baseline - x_height, w, t); break;
+        case 3: FillRect(img, x, middle - t / 2, w, t); break;
+        case 4: FillRect(img, x, baseline - t, w, t); break;
+        case 5: DrawLine(img, x, bottom - 1, x + w - 1, top, t); break;
+        case 6: DrawEllipse(img, x, baseline - x_height, w, x_height, t); break;
+        case 7: FillRect(img, x + w / 2 - t / 2, top - 2 * t, t, t); break;
+        }
+    }
+}
+
+// Page with one or two columns of text, made of lines of words of random glyphs,
+// paragraphs, horizontal rules, and some noise
+static void GenerateDocument(binary_image& img, size_t, size_t, synthetic_rng& rng) {
+    const int w = img.cols_, h = img.rows_;
+    const int size = rng.Int(max(6, h / 64), max(8, h / 24));
+    const int t = max(1, size / 8);
+    const int margin_x = w / 12 + rng.Int(0, w / 24);
+    const int margin_y = h / 12 + rng.Int(0, h / 24);
+    const int columns = rng.Bernoulli(.3) ? 2 : 1;
+    const int gutter = columns > 1 ? size * 2 : 0;
+    const int column_width = (w - 2 * margin_x - gutter * (columns - 1)) / columns;
+    const int line_height = size * rng.Int(12, 16) / 10;
+
+    for (int col = 0; col < columns && column_width > size; ++col) {
+        const int left = margin_x + col * (column_width + gutter), right = left + column_width;
+        bool paragraph_start = true;
+        for (int y = margin_y; y + size <= h - margin_y; y += line_height) {
+            const double event = rng.Uniform();
+            if (event < .08) {
+                // Empty line between paragraphs
+                paragraph_start = true;
+                continue;
+            }
+            if (event < .1) {
+                FillRect(img, left, y + size / 2, column_width, t);
+                paragraph_start = true;
+                continue;
+            }
+
+            // Last lines of paragraphs are shorter
+            const bool paragraph_end = rng.Bernoulli(.15);
+            const int line_end = paragraph_end ? right - rng.Int(0, column_width * 2 / 3) : right;
+            int x = left + (paragraph_start ? size * 2 : 0);
+            paragraph_start = paragraph_end;
+            while (true) {
+                const int letters = rng.Int(1, 9);
+                int word_width = 0;
+                vector<int> widths(letters);
+                for (auto& lw : widths) {
+                    lw = max(2 * t, size * rng.Int(3, 6) / 10);
+                    word_width += lw + t;
+                }
+                if (x + word_width > line_end) {
+                    break;
+                }
+                for (int lw : widths) {
+                    DrawGlyph(img, x, y, lw, size, t, rng);
+                    x += lw + t;
+                }
+                x += size / 2;
+            }
+        }
+    }
+
+    // Scanning noise
+    const size_t noise = img.total() / 2000;
+    for (size_t i = 0; i < noise; ++i) {
+        img(rng.Int(0, h - 1), rng.Int(0, w - 1)) ^= 1;
+    }
+}
+
+// Lattice of random values, interpolated with a smooth step in every dimension
+class value_noise {
+    int cell_;
+    int nx_, ny_, nz_;
+    vector<float> values_;
+
+    static double Smooth(double t) { return t * t * (3 - 2 * t); }
+    float At(int x, int y, int z) const { return values_[(static_cast<size_t>(z) * ny_ + y) * nx_ + x]; }
+
+public:
+    value_noise(int width, int height, int depth, int cell, synthetic_rng& rng) : cell_{ cell },
+        nx_{ width / cell + 2 }, ny_{ height / cell + 2 }, nz_{ depth / cell + 2 },
+        values_(static_cast<size_t>(nx_) * ny_ * nz_) {
+        for (auto& v : values_) {
+            v = static_cast<float>(rng.Uniform());
+        }
+    }
+
+    double operator()(int x, int y, int z) const {
+        const int cx = x / cell_, cy = y / cell_, cz = z / cell_;
+        const double fx = Smooth((x % cell_ + .5) / cell_), fy = Smooth((y % cell_ + .5) / cell_), fz = Smooth((z % cell_ + .5) / cell_);
+        double v[2];
+        for (int k = 0; k < 2; ++k) {
+            const double a = At(cx, cy, cz + k) + (At(cx + 1, cy, cz + k) - At(cx, cy, cz + k)) * fx;
+            const double b = At(cx, cy + 1, cz + k) + (At(cx + 1, cy + 1, cz + k) - At(cx, cy + 1, cz + k)) * fx;
+            v[k] = a + (b - a) * fy;
+        }
+        return v[0] + (v[1] - v[0]) * fz;
+    }
+};
+
+// Blobs: two octaves of value noise thresholded. Images cycle over four blob sizes,
+// and thresholds increase every time the cycle restarts.
+struct blobs_generator {
+    value_noise coarse_, fine_;
+    double threshold_;
+
+    static int Cell(size_t index, int size) { return max(2, min(size, 8 << (index % 4))); }
+
+    blobs_generator(int width, int height, int depth, size_t index, size_t n, synthetic_rng& rng) :
+        coarse_(width, height, depth, Cell(index, max(width, height)), rng),
+        fine_(width, height, depth, max(2, Cell(index, max(width, height)) / 2), rng),
+        threshold_{ Sweep(index / 4, (n + 3) / 4, .35, .65) } {}
+
+    void Slice(binary_image& img, int z) const {
+        for (int r = 0; r < img.rows_; ++r) {
+            uint8_t* row = img.ptr(r);
+            for (int c = 0; c < img.cols_; ++c) {
+                row[c] = (coarse_(c, r, z) + fine_(c, r, z) / 2) / 1.5 > threshold_;
+            }
+        }
+    }
+};
+
+static void GenerateBlobs(binary_image& img, size_t index, size_t n, synthetic_rng& rng) {
+    blobs_generator(img.cols_, img.rows_, 1, index, n, rng).Slice(img, 0);
+}
+
+static void GenerateRandom3D(vector<binary_image>& volume, size_t index, size_t n, synthetic_rng& rng) {
+    for (auto& slice : volume) {
+        GenerateRandom(slice, index, n, rng);
+    }
+}
+
+static void GenerateGranularity3D(vector<binary_image>& volume, size_t index, size_t n, synthetic_rng& rng) {
+    int g;
+    double density;
+    GranularityParameters(index, n, g, density);
+    for (size_t z = 0; z < volume.size(); z += g) {
+        // Blocks are g x g x g, so the slices of a block are equal
+        GenerateGranularity(volume[z], index, n, rng);
+        for (size_t k = z + 1; k < min(volume.size(), z + g); ++k) {
+            volume[k] = volume[z];
+        }
+    }
+}
+
+static void GenerateBlobs3D(vector<binary_image>& volume, size_t index, size_t n, synthetic_rng& rng) {
+    blobs_generator blobs(volume[0].cols_, volume[0].rows_, static_cast<int>(volume.size()), index, n, rng);
+    for (size_t z = 0; z < volume.size(); ++z) {
+        blobs.Slice(volume[z], static_cast<int>(z));
+    }
+}
+
+using image_generator = void(*)(binary_image&, size_t, size_t, synthetic_rng&);
+using volume_generator = void(*)(vector<binary_image>&, size_t, size_t, synthetic_rng&);
+
+struct synthetic_kind {
+    string name;
+    image_generator image;
+    volume_generator volume;
+};
+
+static const vector<synthetic_kind>& Kinds() {
+    static const vector<synthetic_kind> kinds = {
+        { "random", GenerateRandom, nullptr },
+        { "granularity", GenerateGranularity, nullptr },
+        { "documents", GenerateDocument, nullptr },
+        { "blobs", GenerateBlobs, nullptr },
+        { "random3d", nullptr, GenerateRandom3D },
+        { "granularity3d", nullptr, GenerateGranularity3D },
+        { "blobs3d", nullptr, GenerateBlobs3D },
+    };
+    return kinds;
+}
+
+static const synthetic_kind* FindKind(const string& dataset) {
+    if (dataset.compare(0, kSyntheticPrefix.size(), kSyntheticPrefix) != 0) {
+        return nullptr;
+    }
+    const string name = dataset.substr(kSyntheticPrefix.size());
+    for (const auto& k : Kinds()) {
+        if (k.name == name) {
+            return &k;
+        }
+    }
+    return nullptr;
+}
+
+const vector<string>& SyntheticDatasetKinds() {
+    static const vector<string> names = []() {
+        vector<string> v;
+        for (const auto& k : Kinds()) {
+            v.push_back(k.name);
+        }
+        return v;
+    }();
+    return names;
+}
+
+bool IsSyntheticDataset(const string& dataset) {
+    return FindKind(dataset) != nullptr;
+}
+
+bool IsSyntheticVolumeDataset(const string& dataset) {
+    const synthetic_kind* k = FindKind(dataset);
+    return k != nullptr && k->volume != nullptr;
+}
+
+string SyntheticDatasetParameters(const string& dataset) {
+    ostringstream ss;
+    ss << "version " << kSyntheticVersion << ", seed " << conf.synthetic_seed_ << ", images " << conf.synthetic_images_
+       << ", size " << conf.synthetic_width_ << "x" << conf.synthetic_height_;
+    if (IsSyntheticVolumeDataset(dataset)) {
+        ss << "x" << conf.synthetic_depth_;
+    }
+    return ss.str();
+}
+
+bool WritePbm(const path& p, const binary_image& img) {
+    ofstream os(p, ios::binary);
+    if (!os) {
+        return false;
+    }
+    os << "P4\n" << img.cols_ << " " << img.rows_ << "\n";
+    vector<char> row((img.cols_ + 7) / 8);
+    for (int r = 0; r < img.rows_; ++r) {
+        fill(row.begin(), row.end(), 0);
+        const uint8_t* src = img.ptr(r);
+        for (int c = 0; c < img.cols_; ++c) {
+            // In PBM images 1 is black
+            if (!src[c]) {
+                row[c / 8] |= static_cast<char>(0x80 >> (c % 8));
+            }
+        }
+        os.write(row.data(), row.size());
+    }
+    return static_cast<bool>(os);
+}
+
+static string IndexedName(const string& kind, size_t index) {
+    ostringstream ss;
+    ss << kind << "_";
+    ss.width(4);
+    ss.fill('0');
+    ss << index;
+    return ss.str();
+}
+
+bool PrepareSyntheticDataset(const string& dataset) {
+    const synthetic_kind* kind = FindKind(dataset);
+    if (kind == nullptr) {
+        return false;
+    }
+
+    const path dataset_path = conf.global_input_path_ / path(dataset);
+    const string params = SyntheticDatasetParameters(dataset);
+    {
+        ifstream is(dataset_path / kSyntheticParamsFile);
+        string stored;
+        if (is && getline(is, stored) && stored == params && exists(dataset_path / "files.txt")) {
+            return true;
+        }
+    }
+
+    error_code ec;
+    if (exists(dataset_path)) {
+        if (!exists(dataset_path / kSyntheticParamsFile)) {
+            cerr << "ERROR: " << dataset_path << " already exists and was not generated by GRAPHGEN, synthetic dataset " << dataset << " cannot be generated.\n";
+            return false;
+        }
+        remove_all(dataset_path, ec);
+    }
+    if (!create_directories(dataset_path, ec) && ec) {
+        cerr << "ERROR: unable to create " << dataset_path << ".\n";
+        return false;
+    }
+    // params.txt marks the folder as generated by GRAPHGEN before any image is written,
+    // while files.txt is written last: an interrupted generation is repeated
+    {
+        ofstream params_os(dataset_path / kSyntheticParamsFile);
+        params_os << params << "\n";
+        if (!params_os) {
+            cerr << "ERROR: unable to write " << (dataset_path / kSyntheticParamsFile) << ".\n";
+            return false;
+        }
+    }
+
+    const size_t n = conf.synthetic_images_;
+    const int w = static_cast<int>(conf.synthetic_width_), h = static_cast<int>(conf.synthetic_height_);
+    cout << "Generating synthetic dataset " << dataset << " (" << params << ") . . . ";
+    PerformanceEvaluator perf;
+    perf.start();
+
+    vector<string> files;
+    for (size_t i = 0; i < n; ++i) {
+        synthetic_rng rng = ImageRng(kind->name, i);
+        const string name = IndexedName(kind->name, i);
+        if (kind->image) {
+            binary_image img(h, w);
+            kind->image(img, i, n, rng);
+            if (!WritePbm(dataset_path / (name + ".pbm"), img)) {
+                cerr << "\nERROR: unable to write " << (dataset_path / (name + ".pbm")) << ".\n";
+                return false;
+            }
+            files.push_back(name + ".pbm");
+        }
+        else {
+            // Volumes are folders of slices
+            vector<binary_image> volume(conf.synthetic_depth_, binary_image(h, w));
+            kind->volume(volume, i, n, rng);
+            create_directories(dataset_path / name, ec);
+            for (size_t z = 0; z < volume.size(); ++z) {
+                if (!WritePbm(dataset_path / name / (IndexedName("slice", z) + ".pbm"), volume[z])) {
+                    cerr << "\nERROR: unable to write slices into " << (dataset_path / name) << ".\n";
+                    return false;
+                }
+            }
+            files.push_back(name);
+        }
+    }
+
+    ofstream files_os(dataset_path / "files.txt");
+    for (const auto& f : files) {
+        files_os << f << "\n";
+    }
+    if (!files_os) {
+        cerr << "\nERROR: unable to write the files list of " << dataset_path << ".\n";
+        return false;
+    }
+
+    cout << "done. " << perf.stop() << " ms.\n";
+    return true;
+}
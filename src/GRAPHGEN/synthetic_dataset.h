@@ -0,0 +1,53 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_SYNTHETIC_DATASET_H_
+#define GRAPHGEN_SYNTHETIC_DATASET_H_
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "image_io.h"
+
+/** @file synthetic_dataset.h
+
+Generator of reproducible synthetic datasets, which can be used for frequency
+calculation and benchmarking without downloading any data. Datasets are
+named "synthetic/<kind>" and are generated in the input path the first time
+they are used, or whenever the parameters in the "synthetic" section of the
+configuration file change. Available kinds are:
+
+- "random": images with uniformly distributed noise, whose density sweeps
+  from 0 to 1 over the dataset;
+- "granularity": noise made of square blocks of 1 to 16 pixels, with
+  densities from 0.1 to 0.9;
+- "documents": pages of text-like glyphs arranged in lines and paragraphs;
+- "blobs": smooth value noise thresholded at different levels;
+- "random3d", "granularity3d", "blobs3d": volumetric counterparts of the
+  above, stored as stacks of slices.
+
+Images are stored as PBM files, volumes as folders of PBM slices. Images
+only depend on the seed and on the parameters, not on the platform.
+
+ */
+
+const std::vector<std::string>& SyntheticDatasetKinds();
+
+bool IsSyntheticDataset(const std::string& dataset);
+bool IsSyntheticVolumeDataset(const std::string& dataset);
+
+// Parameters the dataset is generated with, as stored in its "params.txt"
+std::string SyntheticDatasetParameters(const std::string& dataset);
+
+// Generates the synthetic dataset if it does not exist or was generated with different
+// parameters. Returns false if dataset is not a valid synthetic dataset, or if it cannot be written.
+bool PrepareSyntheticDataset(const std::string& dataset);
+
+// Stores img as a raw PBM image. Pixels equal to 1 are white.
+bool WritePbm(const std::filesystem::path& p, const binary_image& img);
+
+#endif // !GRAPHGEN_SYNTHETIC_DATASET_H_
@@ -28,33 +28,11 @@
 
 #include "tree2dag_identities.h"
 
-// Search in tree n2 there is a subtree equal to n1, which is not n1
-void FindAndLinkIdentiesRec(BinaryDrag<conact>::node* n1, BinaryDrag<conact>::node* n2) {
-    if (n2->isleaf() || n1 == n2)
-        return;
+#include "remove_equal_subtrees.h"
 
-    if (n1 != n2->left && EqualTrees(n1, n2->left)) {
-        n2->left = n1;
-    }
-
-    if (n1 != n2->right && EqualTrees(n1, n2->right)) {
-        n2->right = n1;
-    }
-
-    FindAndLinkIdentiesRec(n1, n2->left);
-    FindAndLinkIdentiesRec(n1, n2->right);
-}
-
-void Tree2DagUsingIdentitiesRec(BinaryDrag<conact>::node *n, BinaryDrag<conact>& t) {
-    FindAndLinkIdentiesRec(n, t.GetRoot());
-
-    if (!n->isleaf()) {
-        Tree2DagUsingIdentitiesRec(n->left, t);
-        Tree2DagUsingIdentitiesRec(n->right, t);
-    }
-}
-
-// Converts a tree into dag considering only equal subtrees
+// Converts a tree into dag considering only equal subtrees. Equal subtrees are found
+// bottom-up with structural hashes (see RemoveEqualSubtrees), in linear time, instead
+// of comparing every subtree with all the others.
 void Tree2DagUsingIdentities(BinaryDrag<conact>& t) {
-    Tree2DagUsingIdentitiesRec(t.GetRoot(), t);
-}
\ No newline at end of file
+    RemoveEqualSubtrees{ t.roots_.front() };
+}
@@ -9,7 +9,6 @@
 
 #include "conact_tree.h"
 
-void FindAndLinkIdentiesRec(BinaryDrag<conact>::node* n1, BinaryDrag<conact>::node* n2);
 //void Tree2DagUsingIdentitiesRec(BinaryDrag<conact>::node *n, BinaryDrag<conact>& t);
 
 // Converts a tree into dag considering only equal subtrees
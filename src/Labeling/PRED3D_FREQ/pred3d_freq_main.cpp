@@ -0,0 +1,59 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "graphgen.h"
+
+#include "rosenfeld3d_ruleset.h"
+
+using namespace std;
+
+string Description() {
+    return "PRED3D_FREQ (ODT with frequencies + prediction).\n  \
+            Frequencies are calculated over the following datasets: " +
+            conf.GetDatasetsString(", ") + "\n";
+}
+
+int main()
+{
+    // Setup configuration
+    string algorithm_name = "PRED3D_FREQ";
+    conf = ConfigData(algorithm_name, "Rosenfeld3D", true);
+    conf.SetDescription(Description());
+
+    // Load or generate rules
+    Rosenfeld3dRS r_rs;
+    auto rs = r_rs.GetRuleSet();
+
+    // Call GRAPHGEN:
+    // 1) Count frequencies on the volumes of the datasets
+    AddFrequenciesToRuleset(rs);
+
+    // 2) Load or generate Optimal Decision Tree based on Rosenfeld mask
+    BinaryDrag<conact> bd = GetOdt(rs);
+    
+    // 3) Draw the generated tree on file
+    string tree_filename = algorithm_name + "_tree";
+    DrawDagOnFile(tree_filename, bd);
+    
+    // 4) Generate forests of trees
+    LOG(algorithm_name + " - making forests",
+        ForestHandler fh(bd, rs.ps_, ForestHandlerFlags::FIRST_LINE |
+			ForestHandlerFlags::LAST_LINE |
+			ForestHandlerFlags::SINGLE_LINE |
+			ForestHandlerFlags::CENTER_LINES);
+    );
+    
+    // 5) Draw the generated forests on file
+    fh.DrawOnFile(algorithm_name, DrawDagFlags::DELETE_DOTCODE);
+    
+    // 6) Generate the C/C++ source code
+    GeneratePointersConditionsActionsCode(rs, GenerateConditionActionCodeFlags::NONE);
+    auto conditions = GenerateConditions(rs, GenerateConditionActionCodeFlags::NONE);
+    auto actions = GenerateActions(rs, GenerateConditionActionCodeFlags::NONE);
+    fh.GenerateCode(conditions, actions);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "graphgen.h"
+
+#include "rosenfeld3d_ruleset.h"
+
+using namespace std;
+
+string Description() {
+    return "SAUF++3D_FREQ (ODT with frequencies + compression).\n  \
+            Frequencies are calculated over the following datasets: " +
+            conf.GetDatasetsString(", ") + "\n";
+}
+
+int main()
+{
+    string algorithm_name = "SAUF++3D_FREQ";
+    string mask_name = "Rosenfeld3D";
+
+    conf = ConfigData(algorithm_name, mask_name, true);
+    conf.SetDescription(Description());
+
+    Rosenfeld3dRS r_rs;
+    auto rs = r_rs.GetRuleSet();
+
+    // Call GRAPHGEN:
+    // 1) Count frequencies on the volumes of the datasets
+    AddFrequenciesToRuleset(rs);
+
+    // 2) Load or generate Optimal Decision Tree based on Rosenfeld mask
+    BinaryDrag<conact> bd = GetOdt(rs);
+
+    // 3) Draw the generated tree to pdf
+    string tree_filename = algorithm_name + "_tree";
+    DrawDagOnFile(tree_filename, bd);
+
+    // 4) Compress the tree
+    DragCompressor{ bd };
+
+    // 5) Generate the C++ source code for pointers,
+    // conditions to check and actions to perform
+    const auto flags = GenerateConditionActionCodeFlags::CONDITIONS_WITH_IFS | GenerateConditionActionCodeFlags::ACTIONS_WITH_CONTINUE;
+    GeneratePointersConditionsActionsCode(rs, flags);
+    auto conditions = GenerateConditions(rs, flags);
+    auto actions = GenerateActions(rs, flags);
+
+    // 6) Generate the C++ source code for the compressed tree
+    GenerateDragCode(bd, conditions, actions);
+
+    return EXIT_SUCCESS;
+}
@@ -55,7 +55,10 @@ int main()
     // 7) Draw the compressed forests on file
     fh.DrawOnFile(algo_name, DrawDagFlags::DELETE_DOTCODE);
 
-    // 8) Generate the C/C++ code taking care of the names used
+    // 8) Profile the forests on the datasets, for prediction-aware optimizations
+    ProfileForestsOnFile(fh, rs.ps_);
+
+    // 9) Generate the C/C++ code taking care of the names used
     //    in the Grana's rule set GranaRS
     fh.GenerateCode(BeforeMainShiftTwo);
     pixel_set block_positions{
@@ -0,0 +1,108 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Checks CompactDrag against BinaryDrag on random trees, on hash-consed trees and on
+// the forests built from them by LineForestHandler: the conversion BinaryDrag ->
+// CompactDrag -> BinaryDrag must preserve the nodes, the leaves and every root, and
+// CompactDrag::RemoveEqualSubtrees must produce the same drag as RemoveEqualSubtrees.
+
+#include "random_trees.h"
+
+using namespace std;
+
+// Returns whether the two drags have the same number of nodes and leaves and equal roots
+bool SameDrag(const BinaryDrag<conact>& a, const BinaryDrag<conact>& b) {
+    if (a.roots_.size() != b.roots_.size()) {
+        return false;
+    }
+    BinaryDragStatistics sa(a), sb(b);
+    if (sa.Nodes() != sb.Nodes() || sa.Leaves() != sb.Leaves()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.roots_.size(); ++i) {
+        if (!EqualTrees(a.roots_[i], b.roots_[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns the number of failed checks on bd
+int Check(const BinaryDrag<conact>& bd, const string& name) {
+    int failures = 0;
+    auto fail = [&](const string& what) {
+        cout << "ERROR: " << name << ", " << what << "\n";
+        ++failures;
+    };
+
+    CompactDrag cd(bd);
+    BinaryDragStatistics stats(bd);
+    if (cd.Nodes() != stats.Nodes() || cd.Leaves() != stats.Leaves()) {
+        fail("the compact drag has a different number of nodes or leaves");
+    }
+    if (!SameDrag(bd, cd.ToBinaryDrag())) {
+        fail("the round trip changed the drag");
+    }
+    for (size_t i = 0; i < bd.roots_.size(); ++i) {
+        for (size_t j = i + 1; j < bd.roots_.size(); ++j) {
+            if (cd.EqualTrees(cd.roots_[i], cd.roots_[j]) != EqualTrees(bd.roots_[i], bd.roots_[j])) {
+                fail("EqualTrees disagrees on roots " + to_string(i) + " and " + to_string(j));
+            }
+        }
+    }
+
+    BinaryDrag<conact> expected(bd);
+    RemoveEqualSubtrees{ expected };
+    cd.RemoveEqualSubtrees();
+    BinaryDragStatistics expected_stats(expected);
+    if (cd.Nodes() != expected_stats.Nodes() || cd.Leaves() != expected_stats.Leaves()) {
+        fail("RemoveEqualSubtrees left a different number of nodes or leaves");
+    }
+    if (!SameDrag(expected, cd.ToBinaryDrag())) {
+        fail("RemoveEqualSubtrees produced a different drag");
+    }
+    // Only reachable nodes are kept, and no two of them are equal
+    if (cd.nodes_.size() != cd.Nodes() + cd.Leaves()) {
+        fail("RemoveEqualSubtrees kept unreachable nodes");
+    }
+    for (uint32_t a = 0; a < cd.nodes_.size(); ++a) {
+        for (uint32_t b = a + 1; b < cd.nodes_.size(); ++b) {
+            if (cd.EqualTrees(a, b)) {
+                fail("RemoveEqualSubtrees left equal nodes " + to_string(a) + " and " + to_string(b));
+            }
+        }
+    }
+    return failures;
+}
+
+int main() {
+    int failures = 0;
+    for (unsigned seed = 0; seed < 20; ++seed) {
+        const string name = "seed " + to_string(seed);
+
+        BinaryDrag<conact> tree;
+        mt19937 rng(seed);
+        tree.AddRoot(RandomTreeRec(tree, rng, kDepth));
+        failures += Check(tree, name + ", tree");
+
+        BinaryDrag<conact> shared;
+        shared.SetHashConsing(true);
+        mt19937 shared_rng(seed);
+        shared.AddRoot(RandomTreeRec(shared, shared_rng, kDepth));
+        failures += Check(shared, name + ", hash-consed tree");
+
+        LineForestHandler lfh(tree, kPixels);
+        failures += Check(lfh.f_, name + ", main forest");
+        for (size_t i = 0; i < lfh.end_forests_.size(); ++i) {
+            failures += Check(lfh.end_forests_[i], name + ", end forest " + to_string(i));
+        }
+    }
+
+    if (!failures) {
+        cout << "All the compact drags match\n";
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Compares the pattern counting kernels with a reference count on random images,
+// whose widths are not only multiples of the vector width, with the masks of the
+// pixel-based (increment 1) and block-based (increment 2) algorithms.
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "frequency_kernels.h"
+
+using namespace std;
+
+struct test_mask {
+    string name;
+    int border, increment;
+    vector<pattern_pixel> pixels;
+};
+
+// Pixels (dx, dy) of a mask, numbered in order
+vector<pattern_pixel> MaskPixels(const vector<pair<int, int>>& positions) {
+    vector<pattern_pixel> pixels;
+    for (const auto& [dx, dy] : positions) {
+        pixels.push_back({ dy, dx, static_cast<int>(pixels.size()) });
+    }
+    return pixels;
+}
+
+// Binary image of the specified inner size with a border of zeros, and random
+// pixels with the specified density
+vector<uint8_t> RandomImage(mt19937& rng, int rows, int cols, int border, size_t stride, double density) {
+    vector<uint8_t> data(stride * (rows + 2 * border), 0);
+    bernoulli_distribution pixel(density);
+    for (int r = 0; r < rows; ++r) {
+        for (int c = 0; c < cols; ++c) {
+            data[(r + border) * stride + border + c] = pixel(rng);
+        }
+    }
+    return data;
+}
+
+vector<unsigned long long> ReferenceCount(const vector<uint8_t>& data, size_t stride, int height, int width, const test_mask& m) {
+    vector<unsigned long long> freqs(size_t(1) << m.pixels.size(), 0);
+    for (int r = m.border; r < height - m.border; r += m.increment) {
+        for (int c = m.border; c < width - m.border; c += m.increment) {
+            unsigned code = 0;
+            for (const auto& p : m.pixels) {
+                code |= unsigned(data[(r + p.dy) * stride + c + p.dx]) << p.bit;
+            }
+            freqs[code]++;
+        }
+    }
+    return freqs;
+}
+
+int main() {
+    const vector<test_mask> masks = {
+        { "Rosenfeld", 1, 1, MaskPixels({ { -1, -1 }, { 0, -1 }, { 1, -1 }, { -1, 0 }, { 0, 0 } }) },
+        { "2x2 blocks", 3, 2, MaskPixels({ { -2, -2 }, { -1, -2 }, { 0, -2 }, { 1, -2 }, { 2, -2 }, { 3, -2 },
+                                       { -2, -1 }, { -1, -1 }, { 0, -1 }, { 1, -1 }, { 2, -1 }, { 3, -1 },
+                                       { -2, 0 }, { -1, 0 }, { 0, 0 }, { 1, 0 } }) },
+    };
+    const vector<int> widths = { 1, 2, 3, 15, 31, 32, 33, 63, 64, 65, 66, 67, 100, 127, 129, 257 };
+
+    vector<PatternKernel> kernels = { PatternKernel::SCALAR };
+    if (IsPatternKernelSupported(PatternKernel::AVX2)) {
+        kernels.push_back(PatternKernel::AVX2);
+    }
+    else {
+        cout << "WARNING: the CPU does not support AVX2, only the scalar kernel is tested.\n";
+    }
+
+    mt19937 rng(0);
+    int failures = 0, tests = 0;
+    for (const auto& m : masks) {
+        for (int cols : widths) {
+            for (int rows : { 1, 2, 5, 17 }) {
+                for (double density : { 0.1, 0.5, 0.9 }) {
+                    // The stride leaves some room after the border, as images do
+                    const int height = rows + 2 * m.border, width = cols + 2 * m.border;
+                    const size_t stride = width + 7;
+                    vector<uint8_t> data = RandomImage(rng, rows, cols, m.border, stride, density);
+                    vector<unsigned long long> expected = ReferenceCount(data, stride, height, width, m);
+                    for (PatternKernel k : kernels) {
+                        vector<unsigned long long> freqs(expected.size(), 0);
+                        CountPatterns(k, data.data(), stride, height, width, m.border, m.increment, m.pixels, freqs.data());
+                        ++tests;
+                        if (freqs != expected) {
+                            cout << "ERROR: " << PatternKernelName(k) << " kernel, " << m.name << " mask, " << cols << "x" << rows
+                                 << " image with density " << density << ": wrong frequencies\n";
+                            ++failures;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    cout << tests - failures << " of " << tests << " counts are correct\n";
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Checks that hash-consed drags are maximally shared: RemoveEqualSubtrees must not
+// find any equal subtrees in random trees built bottom-up with hash-consing, nor in
+// the main and end forests built from them by LineForestHandler.
+
+#include "random_trees.h"
+
+using namespace std;
+
+// Returns whether RemoveEqualSubtrees left the drag unchanged
+bool MaximallyShared(BinaryDrag<conact>& bd) {
+    BinaryDragStatistics before(bd);
+    RemoveEqualSubtrees{ bd };
+    BinaryDragStatistics after(bd);
+    return before.Nodes() == after.Nodes() && before.Leaves() == after.Leaves();
+}
+
+int main() {
+    int failures = 0;
+    for (unsigned seed = 0; seed < 20; ++seed) {
+        mt19937 rng(seed);
+        BinaryDrag<conact> bd;
+        bd.SetHashConsing(true);
+        bd.AddRoot(RandomTreeRec(bd, rng, kDepth));
+        if (!MaximallyShared(bd)) {
+            cout << "ERROR: seed " << seed << ", the hash-consed tree has equal subtrees\n";
+            ++failures;
+        }
+
+        // Forests need a tree without sharing, whose leaves are numbered one by one
+        BinaryDrag<conact> tree;
+        mt19937 tree_rng(seed);
+        tree.AddRoot(RandomTreeRec(tree, tree_rng, kDepth));
+        LineForestHandler lfh(tree, kPixels);
+        if (!MaximallyShared(lfh.f_)) {
+            cout << "ERROR: seed " << seed << ", the main forest has equal subtrees\n";
+            ++failures;
+        }
+        for (size_t i = 0; i < lfh.end_forests_.size(); ++i) {
+            if (!MaximallyShared(lfh.end_forests_[i])) {
+                cout << "ERROR: seed " << seed << ", end forest " << i << " has equal subtrees\n";
+                ++failures;
+            }
+        }
+    }
+
+    if (!failures) {
+        cout << "All the drags are maximally shared\n";
+    }
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
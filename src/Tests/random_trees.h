@@ -0,0 +1,34 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef GRAPHGEN_TESTS_RANDOM_TREES_H_
+#define GRAPHGEN_TESTS_RANDOM_TREES_H_
+
+#include <random>
+#include <string>
+
+#include "graphgen.h"
+
+// Depth of the random trees
+constexpr int kDepth = 7;
+
+// Conditions of the Rosenfeld mask, so that the trees can be turned into forests
+inline const pixel_set kPixels{ { "p", { -1, -1 } }, { "q", { 0, -1 } }, { "r", { +1, -1 } }, { "s", { -1, 0 } } };
+
+// Builds bottom-up a random tree of the specified depth, which is hash-consed if bd is.
+// Conditions are drawn from kPixels, and each leaf gets one of the first action_sets
+// sets of actions: with few of them many subtrees are equal.
+inline BinaryDrag<conact>::node* RandomTreeRec(BinaryDrag<conact>& bd, std::mt19937& rng, int depth, uint action_sets = 3) {
+    if (depth == 0) {
+        return bd.make_node(conact(uint(rng() % action_sets + 1), 0));
+    }
+    const std::string& condition = kPixels.pixels_[rng() % kPixels.pixels_.size()].name_;
+    BinaryDrag<conact>::node* left = RandomTreeRec(bd, rng, depth - 1, action_sets);
+    BinaryDrag<conact>::node* right = RandomTreeRec(bd, rng, depth - 1, action_sets);
+    return bd.make_node(conact(condition_name(condition)), left, right);
+}
+
+#endif // GRAPHGEN_TESTS_RANDOM_TREES_H_
@@ -45,7 +45,10 @@ int main()
     // 6) Draw the compressed forests on file
     fh.DrawOnFile(algo_name, DrawDagFlags::DELETE_DOTCODE);
 
-    // 7) Generate the C/C++ source code
+    // 7) Profile the forests on the datasets, for prediction-aware optimizations
+    ProfileForestsOnFile(fh, rs.ps_);
+
+    // 8) Generate the C/C++ source code
     fh.GenerateCode();
     GeneratePointersConditionsActionsCode(rs, 
                                           GenerateConditionActionCodeFlags::NONE, 
@@ -0,0 +1,101 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Measures the time required to count frequencies on the synthetic datasets, with
+// every pattern kernel and different numbers of decoder threads. Results are useful
+// to tune the "frequencies" section of the configuration file on a given machine.
+
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+#include "graphgen.h"
+
+#include "grana_ruleset.h"
+#include "rosenfeld_ruleset.h"
+#include "rosenfeld3d_ruleset.h"
+#include "synthetic_dataset.h"
+
+using namespace std;
+
+struct benchmark_result {
+    string mask;
+    string dataset;
+    string kernel;
+    unsigned decode_threads;
+    double ms;
+};
+
+template <typename RS>
+void BenchmarkMask(const string& mask_name, vector<benchmark_result>& results) {
+    // Each mask needs its own output folder, where its rule set is stored
+    string algorithm_name = "FrequenciesBenchmark_" + mask_name;
+    conf = ConfigData(algorithm_name, mask_name, false);
+
+    RS ruleset;
+    const rule_set rs = ruleset.GetRuleSet();
+
+    vector<unsigned> decode_threads = { 1 };
+    if (thread::hardware_concurrency() > 1) {
+        decode_threads.push_back(thread::hardware_concurrency());
+    }
+
+    const ConfigData base_conf = conf;
+    for (const string& kind : SyntheticDatasetKinds()) {
+        const string dataset = "synthetic/" + kind;
+        if (IsSyntheticVolumeDataset(dataset) != (rs.ps_.pixels_.front().size() > 2)) {
+            // Volumes are counted with 3D masks, images with 2D masks
+            continue;
+        }
+        for (PatternKernel kernel : { PatternKernel::SCALAR, PatternKernel::AVX2 }) {
+            if (!IsPatternKernelSupported(kernel)) {
+                continue;
+            }
+            for (unsigned threads : decode_threads) {
+                conf = base_conf;
+                conf.datasets_ = { dataset };
+                conf.frequencies_kernel_ = PatternKernelName(kernel);
+                conf.frequencies_decode_threads_ = threads;
+                // Datasets are generated before timing
+                if (!PrepareSyntheticDataset(dataset)) {
+                    continue;
+                }
+
+                rule_set counted = rs;
+                PerformanceEvaluator perf;
+                perf.start();
+                if (AddFrequenciesToRuleset(counted, true)) {
+                    results.push_back({ mask_name, dataset, conf.frequencies_kernel_, threads, perf.stop() });
+                }
+            }
+        }
+    }
+    conf = base_conf;
+}
+
+int main()
+{
+    vector<benchmark_result> results;
+    BenchmarkMask<RosenfeldRS>("Rosenfeld", results);
+    BenchmarkMask<GranaRS>("Grana", results);
+    BenchmarkMask<Rosenfeld3dRS>("Rosenfeld3D", results);
+
+    const auto report_path = conf.global_output_path_ / "FrequenciesBenchmark.txt";
+    ofstream os(report_path);
+    for (ostream* s : { static_cast<ostream*>(&cout), static_cast<ostream*>(&os) }) {
+        *s << "\n" << left << setw(12) << "mask" << setw(28) << "dataset" << setw(10) << "kernel"
+           << setw(10) << "decoders" << "ms\n";
+        for (const auto& r : results) {
+            *s << left << setw(12) << r.mask << setw(28) << r.dataset << setw(10) << r.kernel
+               << setw(10) << r.decode_threads << r.ms << "\n";
+        }
+    }
+    if (!os) {
+        cerr << "Benchmark results couldn't be stored into " << report_path << ".\n";
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,252 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Counts the frequencies of a mask on a stream of images, e.g. the images processed by
+// a service, without storing them. Images are read from the standard input or from a
+// named pipe, and the frequencies are flushed into a new file every window of frames
+// (or seconds). Window files of many hosts can then be merged with FrequenciesMerge.
+
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+
+#include "graphgen.h"
+#include "system_info.h"
+
+#include "grana_ruleset.h"
+#include "rosenfeld_ruleset.h"
+#include "rosenfeld3d_ruleset.h"
+
+#if defined(GRAPHGEN_WINDOWS)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+using namespace std;
+using namespace filesystem;
+
+struct collector_options {
+    string mask_name;
+    string input;                   // Empty means standard input
+    bool follow = false;            // Reopens the input at the end of the stream
+    path output;
+    string prefix = "window";
+    unsigned long long window_frames = 1000;
+    double window_seconds = 0;      // 0 means that windows are only closed by window_frames
+};
+
+static void Usage() {
+    cerr << "Usage: FrequenciesCollector <mask> [options]\n"
+            "  <mask>                  Rosenfeld, Grana, or Rosenfeld3D\n"
+            "  --input <path>          file or named pipe to read images from (default: standard input)\n"
+            "  --follow                reopen the input named pipe when its writer closes it\n"
+            "  --output <folder>       folder of the window files (default: <output path>/frequencies/<mask>/stream)\n"
+            "  --prefix <name>         prefix of the window files (default: window)\n"
+            "  --window-frames <n>     images per window (default: 1000)\n"
+            "  --window-seconds <s>    maximum duration of a window, 0 for no limit (default: 0)\n"
+            "Images are PNG, raw PBM and PGM, or raw volumes (for 3D masks), concatenated.\n";
+}
+
+static bool ParseOptions(int argc, char** argv, collector_options& opt) {
+    if (argc < 2) {
+        return false;
+    }
+    opt.mask_name = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        const string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--follow") {
+            opt.follow = true;
+        }
+        else if (arg == "--input" && has_value) {
+            opt.input = argv[++i];
+        }
+        else if (arg == "--output" && has_value) {
+            opt.output = argv[++i];
+        }
+        else if (arg == "--prefix" && has_value) {
+            opt.prefix = argv[++i];
+        }
+        else if (arg == "--window-frames" && has_value) {
+            opt.window_frames = max(1ull, strtoull(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--window-seconds" && has_value) {
+            opt.window_seconds = max(0., strtod(argv[++i], nullptr));
+        }
+        else {
+            cerr << "ERROR: invalid argument '" << arg << "'.\n";
+            return false;
+        }
+    }
+    // Reopening a regular file would count the same frames again at every end of file
+    error_code ec;
+    if (opt.follow && (opt.input.empty() || !is_fifo(opt.input, ec))) {
+        cerr << "ERROR: --follow requires the input to be a named pipe.\n";
+        return false;
+    }
+    return true;
+}
+
+class window_collector {
+    const collector_options& opt_;
+    const rule_set& rs_;
+    mask msk_;
+    frequency_file_info info_;
+    vector<unsigned long long> freqs_;
+    unsigned long long frames_ = 0, windows_ = 0;
+    chrono::steady_clock::time_point start_;
+    time_t start_time_;
+
+    void Reset() {
+        fill(freqs_.begin(), freqs_.end(), 0);
+        frames_ = 0;
+        start_ = chrono::steady_clock::now();
+        start_time_ = time(nullptr);
+    }
+
+public:
+    window_collector(const collector_options& opt, const rule_set& rs) : opt_{ opt }, rs_{ rs }, msk_(rs), freqs_(rs.rules.size()) {
+        info_.mask_name = opt.mask_name;
+        info_.dataset_name = "stream " + opt.prefix;
+        info_.condition_order_hash = ConditionOrderHash(rs);
+        Reset();
+    }
+
+    bool Expired() const {
+        return opt_.window_seconds > 0 && chrono::duration<double>(chrono::steady_clock::now() - start_).count() >= opt_.window_seconds;
+    }
+
+    void Add(const vector<uint8_t>& bytes) {
+        bool decoded;
+        if (msk_.dims_ > 2) {
+            // Frames are single files, so they must be raw volumes
+            if (!IsRawVolume(bytes)) {
+                cerr << "WARNING: the frame is a 2D image and cannot be counted with a 3D mask, frame skipped.\n";
+                return;
+            }
+            binary_volume vol;
+            decoded = DecodeBinaryVolume({ bytes }, vol, msk_.border_);
+            if (decoded) {
+                CalculateConfigurationsFrequencyOnVolume(vol, msk_, freqs_);
+            }
+        }
+        else {
+            binary_image img;
+            decoded = DecodeBinaryImage(bytes, img, msk_.border_);
+            if (decoded) {
+                CalculateConfigurationsFrequencyOnImage(img, msk_, freqs_);
+            }
+        }
+        if (!decoded) {
+            cerr << "WARNING: unable to decode a frame, frame skipped.\n";
+            return;
+        }
+        if (++frames_ >= opt_.window_frames) {
+            Flush();
+        }
+    }
+
+    // Writes the frequencies of the current window, if it is not empty, and starts a new one
+    void Flush() {
+        if (frames_ == 0) {
+            Reset();
+            return;
+        }
+        info_.images = frames_;
+        const path p = opt_.output / (opt_.prefix + "_" + to_string(static_cast<long long>(start_time_)) + "_" + to_string(windows_) + conf.frequencies_suffix_);
+        if (SaveFrequencyFile(p, info_, freqs_)) {
+            cout << "Window " << windows_ << ": " << frames_ << " frames written to " << p << ".\n";
+        }
+        else {
+            cerr << "ERROR: window " << windows_ << " couldn't be stored into " << p << ".\n";
+        }
+        ++windows_;
+        Reset();
+    }
+};
+
+static int Collect(const collector_options& opt, const rule_set& rs) {
+    window_collector collector(opt, rs);
+    vector<uint8_t> bytes;
+    string error;
+
+    while (true) {
+        ifstream file;
+        if (!opt.input.empty()) {
+            file.open(opt.input, ios::binary);
+            if (!file) {
+                cerr << "ERROR: unable to open " << opt.input << ".\n";
+                collector.Flush();
+                return EXIT_FAILURE;
+            }
+        }
+        istream& is = opt.input.empty() ? cin : file;
+
+        // Windows are closed by time only when a frame arrives, since reads are blocking
+        while (ReadImageFrame(is, bytes, error)) {
+            if (collector.Expired()) {
+                collector.Flush();
+            }
+            collector.Add(bytes);
+        }
+        if (!error.empty()) {
+            // Frames have no fixed delimiter, so the stream cannot be resynchronized
+            cerr << "ERROR: " << error << ", collection stopped.\n";
+            collector.Flush();
+            return EXIT_FAILURE;
+        }
+        if (!opt.follow) {
+            break;
+        }
+    }
+
+    collector.Flush();
+    return EXIT_SUCCESS;
+}
+
+template <typename RS>
+int Run(collector_options& opt) {
+    string algorithm_name = "FrequenciesCollector_" + opt.mask_name;
+    conf = ConfigData(algorithm_name, opt.mask_name);
+    if (opt.output.empty()) {
+        opt.output = conf.frequencies_path_ / opt.mask_name / "stream";
+    }
+    error_code ec;
+    create_directories(opt.output, ec);
+
+    RS ruleset;
+    const rule_set rs = ruleset.GetRuleSet();
+    return Collect(opt, rs);
+}
+
+int main(int argc, char** argv)
+{
+    collector_options opt;
+    if (!ParseOptions(argc, argv, opt)) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+#if defined(GRAPHGEN_WINDOWS)
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    ios::sync_with_stdio(false);
+
+    if (opt.mask_name == "Rosenfeld") {
+        return Run<RosenfeldRS>(opt);
+    }
+    if (opt.mask_name == "Grana") {
+        return Run<GranaRS>(opt);
+    }
+    if (opt.mask_name == "Rosenfeld3D") {
+        return Run<Rosenfeld3dRS>(opt);
+    }
+    cerr << "ERROR: unknown mask '" << opt.mask_name << "'.\n";
+    Usage();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2020, the GRAPHGEN contributors, as
+// shown by the AUTHORS file. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+// Merges frequency files counted with the same mask, e.g. the windows written by
+// FrequenciesCollector on different hosts, into a single file. Storing the result as
+// "<output path>/frequencies/<mask>/<name>.bin" with "--dataset <name>" allows to use it
+// by listing <name> among the datasets of the configuration file.
+
+#include <iostream>
+#include <limits>
+
+#include "frequency_file.h"
+
+using namespace std;
+using namespace filesystem;
+
+static void Usage() {
+    cerr << "Usage: FrequenciesMerge <output file> <input file>... [--dataset <name>]\n"
+            "  --dataset <name>        dataset name recorded in the output file (default: merged)\n";
+}
+
+int main(int argc, char** argv)
+{
+    path output;
+    vector<path> inputs;
+    string dataset_name = "merged";
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--dataset" && i + 1 < argc) {
+            dataset_name = argv[++i];
+        }
+        else if (arg.rfind("--", 0) == 0) {
+            cerr << "ERROR: invalid argument '" << arg << "'.\n";
+            Usage();
+            return EXIT_FAILURE;
+        }
+        else if (output.empty()) {
+            output = arg;
+        }
+        else {
+            inputs.push_back(arg);
+        }
+    }
+    if (output.empty() || inputs.empty()) {
+        Usage();
+        return EXIT_FAILURE;
+    }
+
+    frequency_file_info info;
+    vector<unsigned long long> freqs;
+    size_t saturated = 0;
+    for (const path& p : inputs) {
+        // Files without header cannot be checked against each other, so they are rejected
+        frequency_file f;
+        string error;
+        if (!f.Open(p, 0, error)) {
+            cerr << "ERROR: unable to open " << p << ": " << error << ".\n";
+            return EXIT_FAILURE;
+        }
+        if (freqs.empty()) {
+            info = f.info();
+            info.images = 0;
+            freqs.resize(f.size());
+        }
+        else {
+            // Files of different datasets can be merged, as long as they were counted with the same rules
+            frequency_file_info expected = info;
+            expected.dataset_name = f.info().dataset_name;
+            if (!f.Matches(expected, freqs.size(), error)) {
+                cerr << "ERROR: " << p << " cannot be merged with " << inputs.front() << ": " << error << ".\n";
+                return EXIT_FAILURE;
+            }
+        }
+        saturated += AddFrequenciesSaturating(freqs, f.data(), f.size());
+        info.images = f.info().images > numeric_limits<uint64_t>::max() - info.images ? numeric_limits<uint64_t>::max() : info.images + f.info().images;
+    }
+
+    if (saturated > 0) {
+        cerr << "WARNING: " << saturated << " frequencies saturated while merging, their values are not exact.\n";
+    }
+
+    info.dataset_name = dataset_name;
+    if (!SaveFrequencyFile(output, info, freqs)) {
+        cerr << "ERROR: merged frequencies couldn't be stored into " << output << ".\n";
+        return EXIT_FAILURE;
+    }
+    cout << inputs.size() << " files (" << info.images << " images) merged into " << output << ".\n";
+
+    return EXIT_SUCCESS;
+}